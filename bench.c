@@ -0,0 +1,480 @@
+/*
+ * Filename: bench.c
+ * Last modified: 16 October 2026
+ * Description: This is the benchmark harness for the shell's hot paths,
+ * built and run by "make bench". Each benchmark times every iteration
+ * separately and prints one JSON object per line with the iteration count
+ * and the mean and percentile latencies in nanoseconds, so that runs can be
+ * compared by a script.
+ *
+ *   smallsh-bench [benchmark...]
+ *
+ * With no arguments every benchmark is run. The number of iterations can be
+ * scaled with the BENCH_SCALE environment variable (default 1). As in the
+ * shell, SMALLSH_ZYGOTE launches commands through the zygote, and the spawn
+ * benchmark is then reported as spawn-zygote. BENCH_BALLAST_MB makes the
+ * process touch that many megabytes first, to see how launch latency
+ * depends on the size of the shell.
+ */
+
+#include "command.h"
+#include "jobTable.h"
+#include "expand.h"
+#include "zygote.h"
+#include "history.h"
+#include "parseCache.h"
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <dirent.h>
+
+#define PARSE_LINE "grep -n -i pattern file1 file2 file3 < in.txt | sort -k2 | uniq -c > out.txt &"
+#define EXPAND_LINE "tar -czf backup-$$.tgz $BENCH_DIR/src ${BENCH_DIR}-$! > /tmp/log-$?.txt"
+#define LONG_LINE_SIZE (1 << 16)
+
+static int scale = 1;
+
+/**
+ * Returns the current monotonic time in nanoseconds.
+ */
+static long long now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compareLongLong(const void* a, const void* b)
+{
+  long long x = *(const long long*)a;
+  long long y = *(const long long*)b;
+
+  return (x > y) - (x < y);
+}
+
+/**
+ * Sorts the given per-iteration latencies and prints their summary as a
+ * single line of JSON. If each iteration processed a number of bytes, the
+ * mean throughput is included too.
+ */
+static void report(const char* name, long long* samples, int count, long long bytes)
+{
+  long long total = 0;
+
+  qsort(samples, count, sizeof(long long), compareLongLong);
+  for (int i = 0; i < count; i++) {
+    total += samples[i];
+  }
+  printf("{\"bench\": \"%s\", \"n\": %d, \"mean_ns\": %lld, \"p50_ns\": %lld, "
+         "\"p90_ns\": %lld, \"p99_ns\": %lld, \"max_ns\": %lld",
+         name, count, total / count, samples[count / 2],
+         samples[(int)(count * 0.90)], samples[(int)(count * 0.99)],
+         samples[count - 1]);
+  if (bytes > 0) {
+    printf(", \"mb_per_s\": %.1f", bytes * count * 1000.0 / total);
+  }
+  printf("}\n");
+  fflush(stdout);
+}
+
+/**
+ * Times createPipeline() followed by destroyPipeline() on a typical line.
+ */
+static void benchParse()
+{
+  int count = 200000 * scale;
+  long long* samples = malloc(count * sizeof(long long));
+  char line[sizeof(PARSE_LINE)];
+  long long start;
+
+  for (int i = 0; i < count; i++) {
+    memcpy(line, PARSE_LINE, sizeof(PARSE_LINE));
+    start = now();
+    destroyPipeline(createPipeline(line));
+    samples[i] = now() - start;
+  }
+  report("parse", samples, count, 0);
+  free(samples);
+}
+
+/**
+ * Times running a repeated step, a typical line with variables, the way the
+ * shell does: once by expanding and parsing it from scratch, and once by
+ * instantiating the parse cache's template for it.
+ */
+static void benchParseCache()
+{
+  int count = 200000 * scale;
+  long long* samples = malloc(count * sizeof(long long));
+  struct ExpandVars vars = {"123456", 0, 654321};
+  struct Expansion out;
+  struct Plan* plan = NULL;
+  int isOpen;
+  long long start;
+
+  expansionInit(&out);
+  setenv("BENCH_DIR", "/home/user/project", 1);
+  for (int i = 0; i < count; i++) {
+    start = now();
+    destroyPipeline(createPipeline(variableExpand(&out, EXPAND_LINE, &vars)));
+    samples[i] = now() - start;
+  }
+  report("parse-expand", samples, count, 0);
+
+  plan = parseCacheLookup(EXPAND_LINE, &isOpen);
+  plan->steps[0].template = templateCreate(plan->steps[0].text);
+  for (int i = 0; i < count; i++) {
+    start = now();
+    plan = parseCacheLookup(EXPAND_LINE, &isOpen);
+    destroyPipeline(templateInstantiate(plan->steps[0].template, &out, &vars));
+    samples[i] = now() - start;
+  }
+  report("parse-cached", samples, count, 0);
+  expansionFree(&out);
+  free(samples);
+}
+
+/**
+ * Times variableExpand() on a typical line with a few variables to expand.
+ */
+static void benchExpand()
+{
+  int count = 200000 * scale;
+  long long* samples = malloc(count * sizeof(long long));
+  struct ExpandVars vars = {"123456", 0, 654321};
+  struct Expansion out;
+  long long start;
+
+  expansionInit(&out);
+  setenv("BENCH_DIR", "/home/user/project", 1);
+  for (int i = 0; i < count; i++) {
+    start = now();
+    variableExpand(&out, EXPAND_LINE, &vars);
+    samples[i] = now() - start;
+  }
+  report("expand", samples, count, strlen(EXPAND_LINE));
+  expansionFree(&out);
+  free(samples);
+}
+
+/**
+ * Times variableExpand() on a long generated line of mostly literal text,
+ * which measures the throughput of the scan and copy.
+ */
+static void benchExpandLong()
+{
+  int count = 20000 * scale;
+  long long* samples = malloc(count * sizeof(long long));
+  struct ExpandVars vars = {"123456", 0, 654321};
+  struct Expansion out;
+  char* line = malloc(LONG_LINE_SIZE + 1);
+  long long start;
+
+  // Words of a few dozen characters, with a variable every so often
+  for (int i = 0; i < LONG_LINE_SIZE; i++) {
+    line[i] = i % 37 == 36 ? ' ' : 'a' + i % 26;
+    if (i % 512 == 0 && i + 12 < LONG_LINE_SIZE) {
+      memcpy(line + i, "${BENCH_DIR}", 12);
+      i += 11;
+    }
+  }
+  line[LONG_LINE_SIZE] = '\0';
+
+  expansionInit(&out);
+  setenv("BENCH_DIR", "/home/user/project", 1);
+  for (int i = 0; i < count; i++) {
+    start = now();
+    variableExpand(&out, line, &vars);
+    samples[i] = now() - start;
+  }
+  report("expand-long", samples, count, LONG_LINE_SIZE);
+  expansionFree(&out);
+  free(line);
+  free(samples);
+}
+
+/**
+ * Times executeCommand() on "true" in the foreground, from launch to the
+ * end of the wait.
+ */
+static void benchSpawn()
+{
+  int count = 2000 * scale;
+  long long* samples = malloc(count * sizeof(long long));
+  struct Command* command = NULL;
+  char line[] = "true";
+  long long start;
+
+  for (int i = 0; i < count; i++) {
+    command = createCommand(line);
+    start = now();
+    executeCommand(command, 1);
+    samples[i] = now() - start;
+    destroyCommand(command);
+  }
+  report(zygoteRunning() ? "spawn-zygote" : "spawn", samples, count, 0);
+  free(samples);
+}
+
+/**
+ * Returns the number of descriptors the process has open.
+ */
+static int countOpenFDs()
+{
+  DIR* dir = opendir("/proc/self/fd");
+  int count = 0;
+
+  if (dir == NULL) {
+    return -1;
+  }
+  while (readdir(dir) != NULL) {
+    count++;
+  }
+  closedir(dir);
+  // Not ".", "..", or the descriptor of the directory itself
+  return count - 3;
+}
+
+/**
+ * Times executeCommand() on "true" with each kind of redirection in turn,
+ * and checks that the number of open descriptors is the same afterwards.
+ * At BENCH_SCALE=10 this launches 100,000 commands. Exits with 1 if any
+ * descriptor was leaked.
+ */
+static void benchRedirect()
+{
+  static const char* lines[] = {
+    "true < /dev/null > /dev/null",
+    "true >> /dev/null 2> /dev/null",
+    "true > /dev/null 2>&1",
+    "true 2>&1 < /dev/null"
+  };
+  int count = 10000 * scale;
+  long long* samples = malloc(count * sizeof(long long));
+  struct Command* command = NULL;
+  char line[64];
+  long long start;
+  int fdsBefore = countOpenFDs();
+  int fdsAfter;
+
+  for (int i = 0; i < count; i++) {
+    strcpy(line, lines[i % 4]);
+    command = createCommand(line);
+    start = now();
+    executeCommand(command, 1);
+    samples[i] = now() - start;
+    destroyCommand(command);
+  }
+  report("redirect", samples, count, 0);
+  free(samples);
+
+  fdsAfter = countOpenFDs();
+  printf("{\"bench\": \"redirect-fds\", \"before\": %d, \"after\": %d}\n",
+         fdsBefore, fdsAfter);
+  fflush(stdout);
+  if (fdsAfter != fdsBefore) {
+    fprintf(stderr, "smallsh-bench: %d descriptors leaked\n", fdsAfter - fdsBefore);
+    exit(1);
+  }
+}
+
+/**
+ * Times recording trace events, with tracing off and then on. Each sample
+ * is the mean of 100 begin and end pairs, since a single event takes about
+ * as long as reading the clock. The buffer is small enough that the timed
+ * events include its flushes to the file.
+ */
+static void benchTrace()
+{
+  int count = 100000 * scale;
+  long long* samples = malloc(count * sizeof(long long));
+  char fileName[] = "/tmp/smallsh-bench-trace-XXXXXX";
+  long long start;
+  int fd = mkstemp(fileName);
+
+  close(fd);
+  for (int on = 0; on <= 1; on++) {
+    if (on && traceOpen(fileName, 4096) == -1) {
+      break;
+    }
+    for (int i = 0; i < count; i++) {
+      start = now();
+      for (int j = 0; j < 100; j++) {
+        TRACE_BEGIN(TRACE_SPAWN);
+        TRACE_END(TRACE_SPAWN, j);
+      }
+      samples[i] = (now() - start) / 200;
+    }
+    report(on ? "trace-event" : "trace-off", samples, count, 0);
+  }
+  traceClose();
+  unlink(fileName);
+  free(samples);
+}
+
+/**
+ * Times historyAdd() while filling a new history file, and then "!prefix"
+ * recall with historyExpand() of lines spread through it. The index is
+ * built by a first recall before the timed ones. At BENCH_SCALE=10 the
+ * history holds a million entries.
+ */
+static void benchHistory()
+{
+  static const char* commands[] = {"grep", "make", "ls", "git", "ssh", "tail", "cd", "vim"};
+  int count = 100000 * scale;
+  int lookups = 10000;
+  long long* samples = malloc(count * sizeof(long long));
+  char fileName[] = "/tmp/smallsh-bench-history-XXXXXX";
+  char line[64];
+  long long start;
+  int fd = mkstemp(fileName);
+
+  close(fd);
+  unlink(fileName);
+  if (historyOpen(fileName, count) == -1) {
+    perror(fileName);
+    free(samples);
+    return;
+  }
+
+  for (int i = 0; i < count; i++) {
+    sprintf(line, "%s%d -v file-%d.txt", commands[i % 8], i % 5000, i);
+    start = now();
+    historyAdd(line);
+    samples[i] = now() - start;
+  }
+  report("history-add", samples, count, 0);
+
+  free(historyExpand("!grep"));
+  for (int i = 0; i < lookups; i++) {
+    sprintf(line, "!%s%d", commands[(i * 7919) % 5000 % 8], (i * 7919) % 5000);
+    start = now();
+    free(historyExpand(line));
+    samples[i] = now() - start;
+  }
+  report("history-recall", samples, lookups, 0);
+
+  historyClose();
+  unlink(fileName);
+  free(samples);
+}
+
+/**
+ * Launches the given line as a background job in the table.
+ */
+static void launchJob(struct JobTable* jobs, const char* text)
+{
+  char line[64];
+  struct Pipeline* pipeline = NULL;
+
+  strcpy(line, text);
+  pipeline = createPipeline(line);
+  if (launchPipeline(pipeline) == 0) {
+    jobTableAdd(jobs, pipeline);
+  }
+  destroyPipeline(pipeline);
+}
+
+/**
+ * Times the shell's reap step, wait4(WNOHANG) then a job table lookup and
+ * removal, for each of a batch of finished background jobs while a large
+ * number of other jobs are still running.
+ */
+static void benchReap()
+{
+  int live = 1000 * scale;
+  int count = 1000 * scale;
+  long long* samples = malloc(count * sizeof(long long));
+  struct JobTable* jobs = jobTableCreate();
+  struct Job* job = NULL;
+  long long start;
+  int reaped = 0;
+  int status;
+  struct rusage usage;
+  pid_t pid;
+
+  for (int i = 0; i < live; i++) {
+    launchJob(jobs, "sleep 60 &");
+  }
+  for (int i = 0; i < count; i++) {
+    launchJob(jobs, "true &");
+  }
+  // Let the short jobs finish before timing their reaping
+  sleep(1);
+
+  while (reaped < count) {
+    start = now();
+    pid = wait4(-1, &status, WNOHANG, &usage);
+    if (pid <= 0) {
+      usleep(1000);
+      continue;
+    }
+    job = jobTableFindPid(jobs, pid);
+    if (job != NULL) {
+      jobFinished(job, status, &usage);
+      jobTableRemove(jobs, job);
+    }
+    samples[reaped] = now() - start;
+    reaped++;
+  }
+  report("reap", samples, count, 0);
+
+  // Clean up the long-running jobs
+  for (int id = 1; id <= jobTableMaxId(jobs); id++) {
+    job = jobTableFindId(jobs, id);
+    if (job != NULL) {
+      kill(job->pid, SIGKILL);
+      waitpid(job->pid, &status, 0);
+    }
+  }
+  jobTableDestroy(jobs);
+  free(samples);
+}
+
+int main(int argc, char *argv[])
+{
+  static const struct { const char* name; void (*run)(); } benchmarks[] = {
+    {"parse", benchParse}, {"parse-cache", benchParseCache},
+    {"expand", benchExpand}, {"expand-long", benchExpandLong},
+    {"spawn", benchSpawn}, {"redirect", benchRedirect},
+    {"history", benchHistory}, {"reap", benchReap},
+    {"trace", benchTrace}
+  };
+  int numBenchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+  char* scaleStr = getenv("BENCH_SCALE");
+  char* ballastStr = getenv("BENCH_BALLAST_MB");
+  char* ballast = NULL;
+  size_t ballastSize = 0;
+
+  if (scaleStr != NULL && atoi(scaleStr) > 0) {
+    scale = atoi(scaleStr);
+  }
+  // The zygote is started first, while the process is still small
+  if (getenv("SMALLSH_ZYGOTE") != NULL) {
+    zygoteStart();
+  }
+  if (ballastStr != NULL && atoi(ballastStr) > 0) {
+    ballastSize = (size_t)atoi(ballastStr) << 20;
+    ballast = malloc(ballastSize);
+    memset(ballast, 1, ballastSize);
+  }
+
+  for (int i = 0; i < numBenchmarks; i++) {
+    int selected = argc == 1;
+    for (int j = 1; j < argc; j++) {
+      selected |= strcmp(argv[j], benchmarks[i].name) == 0;
+    }
+    if (selected) {
+      benchmarks[i].run();
+    }
+  }
+  zygoteStop();
+  free(ballast);
+  return 0;
+}
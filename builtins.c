@@ -0,0 +1,861 @@
+/*
+ * Filename: builtins.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the built-in commands.
+ * They are kept in a table sorted by name, so a command is looked up with a
+ * binary search instead of a chain of comparisons. Besides the commands that
+ * work on the shell itself, the table has in-process versions of common
+ * utilities (echo, printf, test, true, false, pwd), so that running them
+ * doesn't cost a fork and an exec. Redirections are applied around a
+ * built-in by saving and restoring the shell's own stdin, stdout and stderr.
+ */
+
+#include "builtins.h"
+#include "pathCache.h"
+#include "parseCache.h"
+#include "parallel.h"
+#include "history.h"
+#include "capture.h"
+#include "eventLoop.h"
+#include <ctype.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+
+// Descriptors the shell's own stdin and stdout are saved to, out of the way
+// of anything a command is likely to use
+#define SAVED_FD_MIN 10
+
+/**
+ *  This function implements the "exit [n]" built-in. With n, the shell exits
+ *  with that status; otherwise with the status of the last command.
+ */
+static int exitShell(struct Shell* shell, struct Command* command)
+{
+  if (command->numArgs > 1) {
+    shell->lastFgStatus = atoi(command->args[1]);
+  }
+  shell->exitRequested = 1;
+  return shell->lastFgStatus;
+}
+
+/**
+ *  This function implements the "cd [dir]" built-in. Without a directory it
+ *  changes to $HOME.
+ */
+static int changeDir(struct Shell* shell, struct Command* command)
+{
+  if (command->numArgs == 1) {
+  // "cd" is entered with no arguments
+    chdir(getenv("HOME"));
+  } else {
+    chdir(command->args[1]);
+  }
+  return 0;
+}
+
+/**
+ *  This function implements the "status [-v]" built-in. It prints the exit
+ *  value or terminating signal of the last foreground command; with -v it
+ *  also prints the resources that command used, as reported by wait4().
+ */
+static int printStatus(struct Shell* shell, struct Command* command)
+{
+  struct rusage* usage = &shell->lastFgUsage;
+
+  if (shell->lastFgStatus > 1) {
+    printf("terminated by signal %d\n", shell->lastFgStatus);
+  } else {
+    printf("exit value %d\n", shell->lastFgStatus);
+  }
+
+  if (command->numArgs > 1 && strcmp(command->args[1], "-v") == 0) {
+    printf("real %.3fs user %.3fs sys %.3fs\n", shell->lastFgElapsed,
+           usage->ru_utime.tv_sec + usage->ru_utime.tv_usec / 1e6,
+           usage->ru_stime.tv_sec + usage->ru_stime.tv_usec / 1e6);
+    printf("max rss %ld KB\n", usage->ru_maxrss);
+    printf("page faults %ld minor, %ld major\n", usage->ru_minflt, usage->ru_majflt);
+    printf("context switches %ld voluntary, %ld involuntary\n",
+           usage->ru_nvcsw, usage->ru_nivcsw);
+    printf("block I/O %ld in, %ld out\n", usage->ru_inblock, usage->ru_oublock);
+  }
+  fflush(stdout);
+  return 0;
+}
+
+/**
+ *  This function implements the "jobs [-l]" built-in. It lists the background
+ *  jobs in job ID order as "[id] pid command"; with -l, each job's running
+ *  time so far and the user time, system time and max RSS of its last stage
+ *  are shown after its pid. A job started under launch limits shows them
+ *  before its command, as "@" modifiers.
+ */
+static int listJobs(struct Shell* shell, struct Command* command)
+{
+  struct JobTable* jobs = shell->bgJobs;
+  struct Job* job = NULL;
+  int showTime = command->numArgs > 1 && strcmp(command->args[1], "-l") == 0;
+
+  for (int id = 1; id <= jobTableMaxId(jobs); id++) {
+    job = jobTableFindId(jobs, id);
+    if (job == NULL) {
+      continue;
+    }
+    printf("[%d] %d", job->id, job->pid);
+    if (showTime) {
+      jobSampleUsage(job);
+      printf(" %.1fs user %.3fs sys %.3fs max rss %u KB", jobElapsed(job),
+             job->userMillis / 1e3, job->sysMillis / 1e3, job->maxRssKB);
+    }
+    printf(" %s &\n", job->command);
+  }
+  fflush(stdout);
+  return 0;
+}
+
+/**
+ *  The event loop handler for the SIGCHLD signalfd while "wait" waits. The
+ *  signals are drained here; "wait" reaps every child that has exited after
+ *  each one.
+ */
+static void onChildSignal(int fd, void* data)
+{
+  struct signalfd_siginfo info;
+
+  while (read(fd, &info, sizeof(info)) == sizeof(info)) {
+    *(int*)data = 1;
+  }
+}
+
+/**
+ *  This function implements the "wait [id]" built-in. With a job ID (written
+ *  as either "id" or "%id") it blocks until that job finishes; without one it
+ *  waits for every background job. Finished jobs are reported and removed.
+ *  Returns the exit value of the last job waited for, or 1 if the job ID
+ *  does not exist.
+ */
+static int waitJobs(struct Shell* shell, struct Command* command)
+{
+  struct JobTable* jobs = shell->bgJobs;
+  struct Job* job = NULL;
+  char* idStr;
+  pid_t bgPid;
+  int status = 0;
+  struct rusage usage;
+  int result = 0;
+  int signalled;
+
+  if (command->numArgs > 1) {
+    idStr = command->args[1];
+    if (*idStr == '%') {
+      idStr++;
+    }
+    job = jobTableFindId(jobs, atoi(idStr));
+    if (job == NULL) {
+      printf("wait: %s: no such job\n", command->args[1]);
+      fflush(stdout);
+      return 1;
+    }
+    // waitChild() serves the event loop, and so the job's capture pipe,
+    // until the job exits; what is left is read when it is reported
+    waitChild(job->pid, &status, &usage);
+    reportJobDone(jobs, job, status, &usage);
+  } else {
+    // Reap whichever job finishes next until none are left. The event loop
+    // is served in between, so jobs whose output is captured never block on
+    // a full pipe, with the SIGCHLD signalfd to wake it when a job exits.
+    eventLoopAdd(shell->sigFd, onChildSignal, &signalled);
+    while (jobTableSize(jobs) > 0) {
+      bgPid = wait4(-1, &status, WNOHANG, &usage);
+      if (bgPid == -1) {
+        break;
+      }
+      if (bgPid > 0) {
+        job = jobTableFindPid(jobs, bgPid);
+        if (job != NULL) {
+          reportJobDone(jobs, job, status, &usage);
+        }
+        continue;
+      }
+      signalled = 0;
+      while (!signalled) {
+        if (eventLoopWait(-1) == -1 && errno != EINTR) {
+          break;
+        }
+      }
+    }
+    eventLoopRemove(shell->sigFd);
+  }
+
+  if (WIFEXITED(status)) {
+    result = WEXITSTATUS(status);
+  } else {
+    result = WTERMSIG(status);
+  }
+  return result;
+}
+
+/**
+ *  This function implements the "kill [-signal] %id|pid..." built-in. It
+ *  sends the signal (SIGTERM by default) to the process group of each listed
+ *  job, so every stage of a pipeline receives it, and to each listed pid as
+ *  the kill program would. The signal may be
+ *  given by number or by one of the common names, with or without "SIG".
+ *  Returns 0 if every signal was sent, or 1 otherwise.
+ */
+static int killJobs(struct Shell* shell, struct Command* command)
+{
+  struct JobTable* jobs = shell->bgJobs;
+  static const struct { const char* name; int number; } signalNames[] = {
+    {"HUP", SIGHUP}, {"INT", SIGINT}, {"QUIT", SIGQUIT}, {"KILL", SIGKILL},
+    {"USR1", SIGUSR1}, {"USR2", SIGUSR2}, {"TERM", SIGTERM},
+    {"CONT", SIGCONT}, {"STOP", SIGSTOP}
+  };
+  struct Job* job = NULL;
+  char* sigStr;
+  char* end;
+  long pid;
+  int sigNum = SIGTERM;
+  int first = 1;
+  int result = 0;
+
+  if (command->numArgs > 1 && command->args[1][0] == '-') {
+    sigStr = command->args[1] + 1;
+    if (strncmp(sigStr, "SIG", 3) == 0) {
+      sigStr += 3;
+    }
+    sigNum = atoi(sigStr);
+    for (int i = 0; i < (int)(sizeof(signalNames) / sizeof(signalNames[0])); i++) {
+      if (strcmp(sigStr, signalNames[i].name) == 0) {
+        sigNum = signalNames[i].number;
+      }
+    }
+    if (sigNum <= 0) {
+      printf("kill: %s: invalid signal\n", command->args[1]);
+      fflush(stdout);
+      return 1;
+    }
+    first = 2;
+  }
+
+  if (first >= command->numArgs) {
+    printf("Usage: kill [-signal] %%id|pid...\n");
+    fflush(stdout);
+    return 1;
+  }
+
+  for (int i = first; i < command->numArgs; i++) {
+    job = NULL;
+    if (command->args[i][0] != '%') {
+      // kill(0) or a negative pid would signal a whole process group
+      pid = strtol(command->args[i], &end, 10);
+      if (end == command->args[i] || *end != '\0' || pid <= 0) {
+        printf("kill: %s: not a pid or %%id\n", command->args[i]);
+        fflush(stdout);
+        result = 1;
+      } else if (kill(pid, sigNum) == -1) {
+        perror("kill");
+        fflush(stdout);
+        result = 1;
+      }
+      continue;
+    }
+    job = jobTableFindId(jobs, atoi(command->args[i] + 1));
+    if (job == NULL) {
+      printf("kill: %s: no such job\n", command->args[i]);
+      fflush(stdout);
+      result = 1;
+    } else if (kill(-job->pgid, sigNum) == -1) {
+      perror("kill");
+      fflush(stdout);
+      result = 1;
+    }
+  }
+  return result;
+}
+
+/**
+ *  This function implements the "hash" built-in for the command path cache:
+ *  - "hash" lists the cached paths and the hit and miss counters, and the
+ *    counters of the parse cache
+ *  - "hash name..." looks each command up in PATH and caches it
+ *  - "hash -d name..." forgets each command
+ *  - "hash -r" forgets every command
+ *  Returns 0, or 1 if a command could not be found.
+ */
+static int hashCommands(struct Shell* shell, struct Command* command)
+{
+  int result = 0;
+
+  if (command->numArgs == 1) {
+    pathCachePrint();
+    parseCachePrint();
+  } else if (strcmp(command->args[1], "-r") == 0) {
+    pathCacheClear();
+  } else if (strcmp(command->args[1], "-d") == 0) {
+    for (int i = 2; i < command->numArgs; i++) {
+      pathCacheForget(command->args[i]);
+    }
+  } else {
+    for (int i = 1; i < command->numArgs; i++) {
+      if (pathCacheAdd(command->args[i]) != 0) {
+        printf("hash: %s: not found\n", command->args[i]);
+        fflush(stdout);
+        result = 1;
+      }
+    }
+  }
+  return result;
+}
+
+/**
+ *  This function implements the "limit" built-in for the launch limits of
+ *  background pipelines (see launchLimits.c):
+ *  - "limit" prints the limits in force
+ *  - "limit name=value..." sets each limit, and "name=" clears it
+ *  - "limit -r" clears every limit
+ *  A pipeline's own "@" modifiers take precedence over these.
+ *  Returns 0, or 1 if a setting is invalid.
+ */
+static int limit(struct Shell* shell, struct Command* command)
+{
+  char text[LIMITS_TEXT_SIZE];
+  int result = 0;
+
+  if (command->numArgs == 1) {
+    limitsFormat(&shell->bgLimits, text, sizeof(text));
+    printf("%s\n", text[0] != '\0' ? text : "no limits");
+    fflush(stdout);
+  } else if (strcmp(command->args[1], "-r") == 0) {
+    limitsClear(&shell->bgLimits);
+  } else {
+    for (int i = 1; i < command->numArgs; i++) {
+      if (limitsSet(&shell->bgLimits, command->args[i]) == -1) {
+        result = 1;
+      }
+    }
+  }
+  return result;
+}
+
+/**
+ *  This function implements the "history [n]" built-in; see history.c.
+ */
+static int history(struct Shell* shell, struct Command* command)
+{
+  return historyPrint(command->numArgs > 1 ? atol(command->args[1]) : 0);
+}
+
+/**
+ *  This function implements the "output" built-in, which reads back the
+ *  captured output of background jobs (see capture.c):
+ *  - "output" lists the jobs with captured output
+ *  - "output %id" writes what the job has written since the last read
+ *  - "output -f %id" keeps writing it as it arrives, until the job closes
+ *    its output or ctrl-c is pressed
+ *  - "output -o file %id" writes the job's buffer to the file once the job
+ *    has finished
+ *  Returns 0, or 1 if the job has no captured output or the file cannot be
+ *  written.
+ */
+static int output(struct Shell* shell, struct Command* command)
+{
+  const char* fileName = NULL;
+  const char* idStr = NULL;
+  int follow = 0;
+  int result = 0;
+
+  if (command->numArgs == 1) {
+    capturePrint();
+    return 0;
+  }
+  for (int i = 1; i < command->numArgs; i++) {
+    if (strcmp(command->args[i], "-f") == 0) {
+      follow = 1;
+    } else if (strcmp(command->args[i], "-o") == 0 && i + 1 < command->numArgs) {
+      fileName = command->args[++i];
+    } else {
+      idStr = command->args[i];
+    }
+  }
+  if (idStr == NULL) {
+    printf("Usage: output [-f | -o file] %%id\n");
+    fflush(stdout);
+    return 1;
+  }
+
+  if (fileName != NULL) {
+    result = captureFlushTo(atoi(idStr + (*idStr == '%')), fileName);
+  } else if (follow) {
+    result = captureFollow(atoi(idStr + (*idStr == '%')));
+  } else {
+    result = captureWrite(atoi(idStr + (*idStr == '%')), STDOUT_FILENO);
+  }
+  if (result == -1) {
+    printf("output: %s: no captured output\n", idStr);
+    fflush(stdout);
+    result = 1;
+  }
+  return result;
+}
+
+/**
+ *  This function implements the "parallel" built-in; see parallel.c.
+ */
+static int parallel(struct Shell* shell, struct Command* command)
+{
+  return runParallel(command, shell->input);
+}
+
+/**
+ *  This function implements "echo [-n] words...", which writes its words
+ *  separated by spaces, followed by a newline unless -n is given.
+ */
+static int echo(struct Shell* shell, struct Command* command)
+{
+  int first = 1;
+  int newline = 1;
+
+  if (command->numArgs > 1 && strcmp(command->args[1], "-n") == 0) {
+    newline = 0;
+    first = 2;
+  }
+  for (int i = first; i < command->numArgs; i++) {
+    if (i > first) {
+      putchar(' ');
+    }
+    fputs(command->args[i], stdout);
+  }
+  if (newline) {
+    putchar('\n');
+  }
+  return 0;
+}
+
+static int trueCommand(struct Shell* shell, struct Command* command)
+{
+  return 0;
+}
+
+static int falseCommand(struct Shell* shell, struct Command* command)
+{
+  return 1;
+}
+
+/**
+ *  This function implements "pwd", which writes the current directory.
+ */
+static int printDir(struct Shell* shell, struct Command* command)
+{
+  char dir[PATH_MAX];
+
+  if (getcwd(dir, sizeof(dir)) == NULL) {
+    perror("pwd");
+    return 1;
+  }
+  puts(dir);
+  return 0;
+}
+
+/**
+ *  This function evaluates a unary "test" operator on its operand.
+ *  Returns 0 if it is true, 1 if it is false, or 2 if the operator is not
+ *  known.
+ */
+static int testUnary(const char* op, const char* operand)
+{
+  struct stat info;
+
+  if (strcmp(op, "-n") == 0) {
+    return operand[0] == '\0';
+  } else if (strcmp(op, "-z") == 0) {
+    return operand[0] != '\0';
+  } else if (strcmp(op, "-t") == 0) {
+    return !isatty(atoi(operand));
+  } else if (strcmp(op, "-r") == 0) {
+    return access(operand, R_OK) != 0;
+  } else if (strcmp(op, "-w") == 0) {
+    return access(operand, W_OK) != 0;
+  } else if (strcmp(op, "-x") == 0) {
+    return access(operand, X_OK) != 0;
+  } else if (strcmp(op, "-L") == 0 || strcmp(op, "-h") == 0) {
+    return lstat(operand, &info) != 0 || !S_ISLNK(info.st_mode);
+  } else if (strlen(op) != 2 || op[0] != '-' || strchr("edfsp", op[1]) == NULL) {
+    return 2;
+  }
+
+  // The rest are about the file itself
+  if (stat(operand, &info) != 0) {
+    return 1;
+  }
+  switch (op[1]) {
+    case 'd':
+      return !S_ISDIR(info.st_mode);
+    case 'f':
+      return !S_ISREG(info.st_mode);
+    case 's':
+      return info.st_size == 0;
+    case 'p':
+      return !S_ISFIFO(info.st_mode);
+    default:
+      return 0;
+  }
+}
+
+/**
+ *  This function evaluates a binary "test" operator on its operands.
+ *  Returns 0 if it is true, 1 if it is false, or 2 if the operator is not
+ *  known or an integer comparison is given something that isn't one.
+ */
+static int testBinary(const char* left, const char* op, const char* right)
+{
+  static const char* intOps[] = {"-eq", "-ne", "-lt", "-le", "-gt", "-ge"};
+  long long a, b;
+  char* end;
+
+  if (strcmp(op, "=") == 0 || strcmp(op, "==") == 0) {
+    return strcmp(left, right) != 0;
+  } else if (strcmp(op, "!=") == 0) {
+    return strcmp(left, right) == 0;
+  }
+
+  for (int i = 0; i < 6; i++) {
+    if (strcmp(op, intOps[i]) != 0) {
+      continue;
+    }
+    a = strtoll(left, &end, 10);
+    if (left[0] == '\0' || *end != '\0') {
+      printf("test: %s: integer expected\n", left);
+      return 2;
+    }
+    b = strtoll(right, &end, 10);
+    if (right[0] == '\0' || *end != '\0') {
+      printf("test: %s: integer expected\n", right);
+      return 2;
+    }
+    switch (i) {
+      case 0: return !(a == b);
+      case 1: return !(a != b);
+      case 2: return !(a < b);
+      case 3: return !(a <= b);
+      case 4: return !(a > b);
+      default: return !(a >= b);
+    }
+  }
+  return 2;
+}
+
+/**
+ *  This function implements "test expression" and "[ expression ]" for
+ *  expressions of up to three words, optionally negated with "!": a single
+ *  word is true if it is not empty, and otherwise a unary or binary
+ *  operator is applied. "-a", "-o" and parentheses are not supported.
+ *  Returns 0 if the expression is true, 1 if it is false, or 2 on error.
+ */
+static int test(struct Shell* shell, struct Command* command)
+{
+  char** words = command->args + 1;
+  int numWords = command->numArgs - 1;
+  int negate = 0;
+  int result;
+
+  if (strcmp(command->name, "[") == 0) {
+    if (numWords == 0 || strcmp(words[numWords - 1], "]") != 0) {
+      printf("[: missing ]\n");
+      return 2;
+    }
+    numWords--;
+  }
+  if (numWords > 1 && strcmp(words[0], "!") == 0) {
+    negate = 1;
+    words++;
+    numWords--;
+  }
+
+  switch (numWords) {
+    case 0:
+      result = 1;
+      break;
+    case 1:
+      result = words[0][0] == '\0';
+      break;
+    case 2:
+      result = testUnary(words[0], words[1]);
+      break;
+    case 3:
+      result = testBinary(words[0], words[1], words[2]);
+      break;
+    default:
+      result = 2;
+  }
+
+  if (result == 2) {
+    printf("test: unsupported expression\n");
+    return 2;
+  }
+  return negate ? !result : result;
+}
+
+/**
+ *  This function writes the character for the backslash escape that starts
+ *  at the given text, just after the backslash.
+ *  Returns the number of characters of the escape after the backslash.
+ */
+static int printEscape(const char* text)
+{
+  static const char escapes[] = "a\ab\bf\fn\nr\rt\tv\v\\\\";
+  int value = 0;
+  int length = 1;
+
+  if (text[0] == '\0') {
+    putchar('\\');
+    return 0;
+  }
+  if (text[0] == '0') {
+    // Up to three octal digits after the 0
+    while (length < 4 && text[length] >= '0' && text[length] <= '7') {
+      value = value * 8 + text[length] - '0';
+      length++;
+    }
+    putchar(value);
+    return length;
+  }
+  for (int i = 0; escapes[i] != '\0'; i += 2) {
+    if (escapes[i] == text[0]) {
+      putchar(escapes[i + 1]);
+      return 1;
+    }
+  }
+  putchar('\\');
+  putchar(text[0]);
+  return 1;
+}
+
+/**
+ *  This function converts a printf argument to a number, reporting it if
+ *  it isn't one. A missing argument is 0.
+ */
+static long long printfNumber(const char* arg, int* result)
+{
+  long long value;
+  char* end;
+
+  if (arg == NULL) {
+    return 0;
+  }
+  // 'c is the code of the character c
+  if (arg[0] == '\'' || arg[0] == '"') {
+    return (unsigned char)arg[1];
+  }
+  errno = 0;
+  value = strtoll(arg, &end, 0);
+  if (arg[0] == '\0' || *end != '\0' || errno != 0) {
+    printf("printf: %s: invalid number\n", arg);
+    *result = 1;
+  }
+  return value;
+}
+
+/**
+ *  This function implements "printf format [arguments]". The format may
+ *  use backslash escapes and the %s, %c, %d, %i, %u, %o, %x and %X
+ *  conversions with flags, a width and a precision. As in the printf
+ *  program, the format is reused until every argument has been consumed.
+ *  Returns 0, or 1 if an argument or the format was bad.
+ */
+static int printfCommand(struct Shell* shell, struct Command* command)
+{
+  const char* format;
+  const char* arg;
+  char spec[40];
+  int nextArg = 2;
+  int consumed;
+  int specLength;
+  int result = 0;
+
+  if (command->numArgs < 2) {
+    printf("Usage: printf format [arguments]\n");
+    return 2;
+  }
+
+  do {
+    consumed = nextArg;
+    for (format = command->args[1]; *format != '\0'; format++) {
+      if (*format == '\\') {
+        format += printEscape(format + 1);
+        continue;
+      }
+      if (*format != '%') {
+        putchar(*format);
+        continue;
+      }
+      if (format[1] == '%') {
+        putchar('%');
+        format++;
+        continue;
+      }
+
+      // Copy the flags, width and precision into a format of our own
+      spec[0] = '%';
+      specLength = 1;
+      format++;
+      while (*format != '\0' && strchr("-+ #0123456789.", *format) != NULL
+             && specLength < (int)sizeof(spec) - 4) {
+        spec[specLength++] = *format++;
+      }
+      arg = nextArg < command->numArgs ? command->args[nextArg++] : NULL;
+
+      switch (*format) {
+        case 's':
+          strcpy(spec + specLength, "s");
+          printf(spec, arg != NULL ? arg : "");
+          break;
+        case 'c':
+          strcpy(spec + specLength, "c");
+          if (arg != NULL && arg[0] != '\0') {
+            printf(spec, arg[0]);
+          }
+          break;
+        case 'd':
+        case 'i':
+          strcpy(spec + specLength, "lld");
+          printf(spec, printfNumber(arg, &result));
+          break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+          sprintf(spec + specLength, "ll%c", *format);
+          printf(spec, (unsigned long long)printfNumber(arg, &result));
+          break;
+        default:
+          printf("printf: %%%c: invalid directive\n", *format);
+          return 1;
+      }
+    }
+  } while (nextArg < command->numArgs && nextArg > consumed);
+
+  return result;
+}
+
+// Sorted by name for builtinLookup()
+static const struct Builtin builtins[] = {
+  {"[", test, BUILTIN_UTILITY},
+  {"cd", changeDir, BUILTIN_NO_STATUS},
+  {"echo", echo, BUILTIN_UTILITY},
+  {"exit", exitShell, BUILTIN_NO_STATUS},
+  {"false", falseCommand, BUILTIN_UTILITY},
+  {"hash", hashCommands, 0},
+  {"history", history, 0},
+  {"jobs", listJobs, BUILTIN_NO_STATUS},
+  {"kill", killJobs, 0},
+  {"limit", limit, 0},
+  {"output", output, 0},
+  {"parallel", parallel, 0},
+  {"printf", printfCommand, BUILTIN_UTILITY},
+  {"pwd", printDir, BUILTIN_UTILITY},
+  {"status", printStatus, BUILTIN_NO_STATUS},
+  {"test", test, BUILTIN_UTILITY},
+  {"true", trueCommand, BUILTIN_UTILITY},
+  {"wait", waitJobs, 0}
+};
+
+static int compareName(const void* name, const void* builtin)
+{
+  return strcmp((const char*)name, ((const struct Builtin*)builtin)->name);
+}
+
+/**
+ * Returns the built-in with the given name, or NULL if there isn't one.
+ */
+const struct Builtin* builtinLookup(const char* name)
+{
+  return bsearch(name, builtins, sizeof(builtins) / sizeof(builtins[0]),
+                 sizeof(struct Builtin), compareName);
+}
+
+/**
+ * Points the given descriptor at the file, keeping a copy of what it was.
+ * Returns the copy, or -1 after printing why the file could not be opened.
+ */
+static int redirect(int fd, const char* fileName, int flags, const char* what)
+{
+  int fileFD = open(fileName, flags | O_CLOEXEC, 0644);
+  int savedFD;
+
+  if (fileFD == -1) {
+    printf("cannot open %s for %s\n", fileName, what);
+    fflush(stdout);
+    return -1;
+  }
+  savedFD = fcntl(fd, F_DUPFD_CLOEXEC, SAVED_FD_MIN);
+  dup2(fileFD, fd);
+  close(fileFD);
+  return savedFD;
+}
+
+/**
+ * Puts back a descriptor saved by redirect().
+ */
+static void restore(int fd, int savedFD)
+{
+  if (savedFD != -1) {
+    dup2(savedFD, fd);
+    close(savedFD);
+  }
+}
+
+/**
+ *  This function runs a built-in in the shell process. Its redirections
+ *  replace the shell's stdin, stdout and stderr while it runs, and stdout is
+ *  flushed on either side so output goes to the right place.
+ *  Returns the built-in's status, or 1 if a redirection failed.
+ */
+int runBuiltin(const struct Builtin* builtin, struct Shell* shell, struct Command* command)
+{
+  int savedFDs[3] = {-1, -1, -1};
+  int result = 0;
+
+  fflush(stdout);
+  fflush(stderr);
+  if (command->inputFile != NULL) {
+    savedFDs[0] = redirect(STDIN_FILENO, command->inputFile, O_RDONLY, "input");
+    result |= savedFDs[0] == -1;
+  }
+  if (result == 0 && command->outputFile != NULL) {
+    savedFDs[1] = redirect(STDOUT_FILENO, command->outputFile, O_WRONLY | O_CREAT
+                           | (command->appendOutput ? O_APPEND : O_TRUNC), "output");
+    result |= savedFDs[1] == -1;
+  }
+  if (result == 0 && command->errorFile != NULL) {
+    savedFDs[2] = redirect(STDERR_FILENO, command->errorFile,
+                           O_WRONLY | O_CREAT | O_TRUNC, "errors");
+    result |= savedFDs[2] == -1;
+  }
+  if (result == 0 && command->errorToOutput) {
+    savedFDs[2] = fcntl(STDERR_FILENO, F_DUPFD_CLOEXEC, SAVED_FD_MIN);
+    dup2(STDOUT_FILENO, STDERR_FILENO);
+  }
+
+  if (result == 0) {
+    result = builtin->run(shell, command);
+  }
+
+  fflush(stdout);
+  fflush(stderr);
+  for (int i = 2; i >= 0; i--) {
+    restore(i, savedFDs[i]);
+  }
+  if (savedFDs[0] != -1) {
+    clearerr(stdin);
+  }
+  return result;
+}
@@ -0,0 +1,30 @@
+/*
+ * Filename: builtins.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the table of
+ * built-in commands, which run inside the shell process.
+ */
+
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+#include "shell.h"
+#include "command.h"
+
+// The built-in only stands in for a program of the same name, which is run
+// instead when the command is part of a pipeline or runs in the background
+#define BUILTIN_UTILITY   0x1
+// Running the built-in leaves the status of the last command alone
+#define BUILTIN_NO_STATUS 0x2
+
+struct Builtin
+{
+  const char* name;
+  int (*run)(struct Shell* shell, struct Command* command);
+  int flags;
+};
+
+const struct Builtin* builtinLookup(const char* name);
+int runBuiltin(const struct Builtin* builtin, struct Shell* shell, struct Command* command);
+
+#endif
@@ -0,0 +1,420 @@
+/*
+ * Filename: capture.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the capture of background
+ * job output. With SMALLSH_CAPTURE set to a size in bytes, a background job
+ * that would have written to /dev/null writes its stdout and stderr to a
+ * pipe instead. The read end is non-blocking and watched by the shell's
+ * event loop, which copies whatever arrives into a ring buffer of that size
+ * kept for the job; once it is full the oldest bytes are dropped and
+ * counted. The pipes are drained between lines, while the shell waits for
+ * input or for a foreground command, and while "wait" or "output -f"
+ * waits, so a chatty job only stalls on a full pipe while a built-in such
+ * as "parallel" runs.
+ *
+ * Captures are indexed by job ID. A capture outlives its job until it is
+ * read with "output %id", written to its file, or its ID is given to a new
+ * job.
+ */
+
+#define _GNU_SOURCE   // pipe2()
+#include "capture.h"
+#include "eventLoop.h"
+#include <assert.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define READ_CHUNK 65536
+
+struct Capture
+{
+  int jobId;
+  pid_t pid;
+  int fd;             // Read end of the job's pipe, or -1 once it is closed
+  int done;           // The job has been reaped
+  char* ring;
+  unsigned long long written;   // Bytes received since the job started
+  unsigned long long consumed;  // Bytes already written out by "output"
+  char* fileName;     // Where the buffer goes when the job finishes, or NULL
+};
+
+static size_t ringSize = 0;   // 0 means output is not captured
+static struct Capture** captures = NULL;  // Indexed by job ID
+static int numCaptures = 0;
+static int pendingFD = -1;    // Read end between captureBegin() and captureCommit()
+static volatile sig_atomic_t followInterrupted = 0;
+
+/**
+ * Sets the size of each job's ring buffer. 0 turns capture off for jobs
+ * started from now on.
+ */
+void captureSetSize(size_t size)
+{
+  ringSize = size;
+}
+
+/**
+ * Frees a capture, closing and unwatching its pipe if it is still open.
+ */
+static void destroyCapture(struct Capture* capture)
+{
+  if (capture->fd != -1) {
+    eventLoopRemove(capture->fd);
+    close(capture->fd);
+  }
+  captures[capture->jobId] = NULL;
+  free(capture->fileName);
+  free(capture->ring);
+  free(capture);
+}
+
+/**
+ * Returns the capture of the given job ID, or NULL if it has none.
+ */
+static struct Capture* findCapture(int jobId)
+{
+  if (jobId <= 0 || jobId >= numCaptures) {
+    return NULL;
+  }
+  return captures[jobId];
+}
+
+/**
+ * Copies bytes into the ring buffer, overwriting the oldest ones.
+ */
+static void ringAppend(struct Capture* capture, const char* data, size_t length)
+{
+  size_t start, first;
+
+  if (length > ringSize) {
+    capture->written += length - ringSize;
+    data += length - ringSize;
+    length = ringSize;
+  }
+  start = capture->written % ringSize;
+  first = ringSize - start < length ? ringSize - start : length;
+  memcpy(capture->ring + start, data, first);
+  memcpy(capture->ring, data + first, length - first);
+  capture->written += length;
+}
+
+/**
+ * Returns the number of bytes that were dropped before they could be read.
+ */
+static unsigned long long droppedBytes(struct Capture* capture)
+{
+  if (capture->written - capture->consumed > ringSize) {
+    return capture->written - capture->consumed - ringSize;
+  }
+  return 0;
+}
+
+/**
+ * Reads from a capture's pipe into its ring buffer. At most one chunk is
+ * read per call unless all is set, so that one busy job cannot keep the
+ * event loop from the others. The pipe is closed once every writer has
+ * closed it.
+ */
+static void readCapture(struct Capture* capture, int all)
+{
+  char buffer[READ_CHUNK];
+  ssize_t count;
+
+  while (capture->fd != -1) {
+    count = read(capture->fd, buffer, sizeof(buffer));
+    if (count > 0) {
+      ringAppend(capture, buffer, count);
+      if (!all) {
+        return;
+      }
+    } else if (count == -1 && errno == EINTR) {
+      continue;
+    } else if (count == -1 && errno == EAGAIN) {
+      return;
+    } else {
+      eventLoopRemove(capture->fd);
+      close(capture->fd);
+      capture->fd = -1;
+    }
+  }
+}
+
+/**
+ * The event loop handler for a capture's pipe.
+ */
+static void onCaptureReadable(int fd, void* data)
+{
+  readCapture(data, 0);
+}
+
+/**
+ * Writes out the part of the ring buffer from the given offset to the end
+ * of what has been received.
+ * Returns 0, or -1 if the write failed.
+ */
+static int writeRing(struct Capture* capture, int fd, unsigned long long from)
+{
+  size_t start = from % ringSize;
+  size_t length = capture->written - from;
+  size_t first = ringSize - start < length ? ringSize - start : length;
+
+  if (write(fd, capture->ring + start, first) != (ssize_t)first) {
+    return -1;
+  }
+  if (length > first && write(fd, capture->ring, length - first) != (ssize_t)(length - first)) {
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Returns the offset of the oldest byte still in the ring buffer.
+ */
+static unsigned long long oldestByte(struct Capture* capture)
+{
+  return capture->written > ringSize ? capture->written - ringSize : 0;
+}
+
+/**
+ * Writes the whole ring buffer to the given file, replacing its contents.
+ * Returns 0, or 1 after printing why the file could not be written.
+ */
+static int writeFile(struct Capture* capture, const char* fileName)
+{
+  int fd = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  int result = 0;
+
+  if (fd == -1 || writeRing(capture, fd, oldestByte(capture)) == -1) {
+    printf("cannot write output of job %d to %s\n", capture->jobId, fileName);
+    fflush(stdout);
+    result = 1;
+  }
+  if (fd != -1) {
+    close(fd);
+  }
+  return result;
+}
+
+/**
+ *  This function creates the pipe for the output of a background job about
+ *  to be launched, if output is being captured.
+ *  Returns the write end for the job, or -1 if its output is not captured.
+ *  The read end is kept until captureCommit() or captureCancel().
+ */
+int captureBegin()
+{
+  int fds[2];
+
+  if (ringSize == 0 || pipe2(fds, O_CLOEXEC) == -1) {
+    return -1;
+  }
+  fcntl(fds[0], F_SETFL, O_NONBLOCK);
+  pendingFD = fds[0];
+  return fds[1];
+}
+
+/**
+ *  This function gives the pipe made by captureBegin() to the job that was
+ *  launched with it and starts collecting its output. Any capture left over
+ *  from an earlier job with the same ID is dropped.
+ */
+void captureCommit(int jobId, pid_t pid)
+{
+  struct Capture* capture;
+  int oldNumCaptures = numCaptures;
+
+  if (pendingFD == -1) {
+    return;
+  }
+  if (jobId >= numCaptures) {
+    numCaptures = jobId < 16 ? 32 : 2 * jobId;
+    captures = realloc(captures, numCaptures * sizeof(struct Capture*));
+    assert(captures != 0);
+    memset(captures + oldNumCaptures, 0,
+           (numCaptures - oldNumCaptures) * sizeof(struct Capture*));
+  }
+  if (captures[jobId] != NULL) {
+    destroyCapture(captures[jobId]);
+  }
+
+  capture = calloc(1, sizeof(struct Capture));
+  capture->ring = malloc(ringSize);
+  assert(capture != 0 && capture->ring != 0);
+  capture->jobId = jobId;
+  capture->pid = pid;
+  capture->fd = pendingFD;
+  pendingFD = -1;
+  captures[jobId] = capture;
+  if (eventLoopAdd(capture->fd, onCaptureReadable, capture) == -1) {
+    perror("capture");
+    fflush(stdout);
+  }
+}
+
+/**
+ *  This function closes the pipe made by captureBegin() when the job could
+ *  not be launched.
+ */
+void captureCancel()
+{
+  if (pendingFD != -1) {
+    close(pendingFD);
+    pendingFD = -1;
+  }
+}
+
+/**
+ *  This function is called when a background job has been reaped. It
+ *  collects whatever output is left in the pipe, and writes the buffer to
+ *  its file if "output -o" asked for that.
+ */
+void captureJobDone(int jobId)
+{
+  struct Capture* capture = findCapture(jobId);
+
+  if (capture == NULL) {
+    return;
+  }
+  // Every writer that has exited has closed its end, but a stage that is
+  // still running may keep the pipe open, so read without waiting for EOF
+  readCapture(capture, 1);
+  if (capture->fd != -1) {
+    eventLoopRemove(capture->fd);
+    close(capture->fd);
+    capture->fd = -1;
+  }
+  capture->done = 1;
+  if (capture->fileName != NULL) {
+    writeFile(capture, capture->fileName);
+    destroyCapture(capture);
+  }
+}
+
+/**
+ *  This function writes the output of the given job that has not been read
+ *  yet to fd, after a note of how many bytes were dropped if the buffer
+ *  overflowed. The capture of a finished job is freed once it has been read.
+ *  Returns 0, or -1 if the job has no captured output.
+ */
+int captureWrite(int jobId, int fd)
+{
+  struct Capture* capture = findCapture(jobId);
+  unsigned long long dropped;
+
+  if (capture == NULL) {
+    return -1;
+  }
+  fflush(stdout);
+  dropped = droppedBytes(capture);
+  if (dropped > 0) {
+    dprintf(fd, "[output: %llu bytes dropped]\n", dropped);
+  }
+  writeRing(capture, fd, capture->consumed + dropped);
+  capture->consumed = capture->written;
+  if (capture->done) {
+    destroyCapture(capture);
+  }
+  return 0;
+}
+
+static void handle_followSIGINT(int sigNum)
+{
+  followInterrupted = 1;
+}
+
+/**
+ *  This function writes the output of the given job to stdout as it
+ *  arrives, until the job closes its output or ctrl-c is pressed.
+ *  Returns 0, or -1 if the job has no captured output.
+ */
+int captureFollow(int jobId)
+{
+  struct Capture* capture = findCapture(jobId);
+  struct sigaction follow = {{0}};
+  struct sigaction saved;
+  int isOpen;
+
+  if (capture == NULL) {
+    return -1;
+  }
+
+  // The shell ignores SIGINT; catch it for as long as this runs instead
+  follow.sa_handler = handle_followSIGINT;
+  sigfillset(&follow.sa_mask);
+  sigaction(SIGINT, &follow, &saved);
+  followInterrupted = 0;
+
+  do {
+    isOpen = capture->fd != -1;
+    if (captureWrite(jobId, STDOUT_FILENO) == -1 || !isOpen) {
+      break;    // The capture was finished and freed, or the pipe has closed
+    }
+    eventLoopWait(-1);
+    capture = findCapture(jobId);
+  } while (capture != NULL && !followInterrupted);
+
+  sigaction(SIGINT, &saved, NULL);
+  if (followInterrupted) {
+    printf("\n");
+    fflush(stdout);
+  }
+  return 0;
+}
+
+/**
+ *  This function writes the whole buffer of the given job to a file: now if
+ *  the job has finished, or else as soon as it does.
+ *  Returns 0, 1 if the file cannot be written, or -1 if the job has no
+ *  captured output.
+ */
+int captureFlushTo(int jobId, const char* fileName)
+{
+  struct Capture* capture = findCapture(jobId);
+
+  if (capture == NULL) {
+    return -1;
+  }
+  if (capture->done) {
+    return writeFile(capture, fileName);
+  }
+  free(capture->fileName);
+  capture->fileName = strdup(fileName);
+  return 0;
+}
+
+/**
+ *  This function lists every capture with the number of bytes waiting to be
+ *  read and dropped.
+ */
+void capturePrint()
+{
+  struct Capture* capture;
+  unsigned long long dropped;
+
+  if (ringSize == 0) {
+    printf("output is not being captured; set SMALLSH_CAPTURE to a buffer size\n");
+  }
+  for (int i = 1; i < numCaptures; i++) {
+    capture = captures[i];
+    if (capture == NULL) {
+      continue;
+    }
+    dropped = droppedBytes(capture);
+    printf("[%d] %d %s, %llu bytes", capture->jobId, capture->pid,
+           capture->done ? "done" : "running",
+           capture->written - capture->consumed - dropped);
+    if (dropped > 0) {
+      printf(", %llu dropped", dropped);
+    }
+    if (capture->fileName != NULL) {
+      printf(", to %s", capture->fileName);
+    }
+    printf("\n");
+  }
+  fflush(stdout);
+}
@@ -0,0 +1,24 @@
+/*
+ * Filename: capture.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the capture of
+ * background job output into per-job ring buffers, which the "output"
+ * built-in reads back.
+ */
+
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <sys/types.h>
+
+void captureSetSize(size_t size);
+int captureBegin();
+void captureCommit(int jobId, pid_t pid);
+void captureCancel();
+void captureJobDone(int jobId);
+int captureWrite(int jobId, int fd);
+int captureFollow(int jobId);
+int captureFlushTo(int jobId, const char* fileName);
+void capturePrint();
+
+#endif
@@ -2,70 +2,76 @@
  * Filename: command.c
  * Author: Aaron Ennis
  * Email: ennisa@oregonstate.edu
- * Last modified: 5 November 2020
+ * Last modified: 16 October 2026
  * Description: This is the implementation file that defines a structure
  * to contain information about a command, and some simple functions to 
  * operate on the structure.
  */
 
+#define _GNU_SOURCE   // pipe2() and F_SETPIPE_SZ
 #include "command.h"
+#include "pathCache.h"
+#include "zygote.h"
+#include "metrics.h"
+#include "trace.h"
+#include "eventLoop.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
 #include <sys/wait.h>
+#include <sys/time.h>
 #include <unistd.h>
 #include <fcntl.h>
+#include <errno.h>
+#include <spawn.h>
+#include <sys/syscall.h>
 
-/** 
- * This function creates a new Command struct by parsing the command name and
- * its arguments from a string with no particular format.  
- * Parameters: A pointer to a character array
- * Return value: A pointer to a structure containing the
+extern char** environ;
+
+static char devNull[] = "/dev/null";  // For background commands w/o redirect
+
+/**
+ * This function tokenizes a single command in place. The words of the
+ * string become the command's name and arguments, except that the word after
+ * a "<", ">" or ">>", or "2>" becomes the input, output or error file. The argument pointers are
+ * stored in argSpace, which must have room for every word plus the NULL that
+ * execvp() requires at the end. Nothing is copied or allocated: every
+ * pointer in the command points into the string.
  */
-struct Command* createCommand(char* rawData)
+static void parseCommand(struct Command* command, char* text, char** argSpace)
 {
   char *token;
   char *saveptr;
-  char *devNull = "/dev/null";  // For background commands w/o redirect
-	struct Command* newCommand = malloc(sizeof(struct Command));
+
   // Default exitStatus and runScope for built-in commands
-  //newCommand->exitStatus = 0;
-  newCommand->runScope = 0;   // 0 = foreground, 1 = background
+  command->exitStatus = 0;
+  command->runScope = 0;   // 0 = foreground, 1 = background
   // Default  file names for redirection to NULL
-  newCommand->inputFile = NULL;
-  newCommand->outputFile = NULL;
-  newCommand->numArgs = 0;
-
-  
-  /* If the last characters in the string are '&' preceded by a space, set
-   * the runScope flag to 1 to indicate this command should be run in the 
-   * background and trim the '&' and trailing space from the string
-   */
-
-  if (strcmp(rawData + strlen(rawData) - 2, " &") == 0) {
-    newCommand->runScope = 1;
-    rawData[strlen(rawData) - 2] = '\0';
-  }
-
-  /* Get the first token, which we will assume is the command name, and copy it
-   * into the Command struct's name member variable.
-   */
-  token = strtok_r(rawData, " ", &saveptr);
-  newCommand->name = calloc(strlen(token) + 1, sizeof(char));
-  strcpy(newCommand->name, token);
+  command->inputFile = NULL;
+  command->outputFile = NULL;
+  command->errorFile = NULL;
+  command->appendOutput = 0;
+  command->errorToOutput = 0;
+  command->args = argSpace;
+  command->numArgs = 0;
+  command->myPid = 0;
 
-  /* Copy the command name into the arg array as the first element, as required
-   * by execvp() and increment the counter.
+  /* Get the first token, which we will assume is the command name. It is
+   * also the first element of the arg array, as required by execvp().
    */
-  newCommand->args[newCommand->numArgs] = calloc(strlen(token) + 1, sizeof(char));
-  strcpy(newCommand->args[newCommand->numArgs], token);
-  newCommand->numArgs++;
+  token = strtok_r(text, " ", &saveptr);
+  command->name = token;
+  if (token != NULL) {
+    command->args[command->numArgs] = token;
+    command->numArgs++;
+  }
 
   /* Run through the remainder of the string. If we encounter a '<' character,
-   * the next token will get copied into inputFile. If we encounter a '>'
-   * character, the next token will get copied into outputFile.
+   * the next token is the inputFile. If we encounter a '>' or '>>', the next
+   * token is the outputFile, and after '2>' it is the errorFile. '2>&1'
+   * sends stderr wherever stdout goes.
    */
-  do {
+  while (token != NULL) {
     token = strtok_r(NULL, " ", &saveptr);
     if (token == NULL) {
       break;
@@ -73,39 +79,231 @@ struct Command* createCommand(char* rawData)
     if (strcmp(token, "<") == 0) {
       // Store the file name for input redirection
       token = strtok_r(NULL, " ", &saveptr);
-      newCommand->inputFile = calloc(strlen(token) + 1, sizeof(char));
-      strcpy(newCommand->inputFile, token);
-    } else if (strcmp(token, ">") == 0) {
+      command->inputFile = token;
+    } else if (strcmp(token, ">") == 0 || strcmp(token, ">>") == 0) {
       // Store the file name for output redirection
+      command->appendOutput = token[1] == '>';
       token = strtok_r(NULL, " ", &saveptr);
-      newCommand->outputFile = calloc(strlen(token) + 1, sizeof(char));
-      strcpy(newCommand->outputFile, token);
+      command->outputFile = token;
+    } else if (strcmp(token, "2>") == 0) {
+      // Store the file name for error redirection
+      token = strtok_r(NULL, " ", &saveptr);
+      command->errorFile = token;
+      command->errorToOutput = 0;
+    } else if (strcmp(token, "2>&1") == 0) {
+      command->errorToOutput = 1;
+      command->errorFile = NULL;
     } else {
       // Store the argument in the args array and increment the counter
-      newCommand->args[newCommand->numArgs] = calloc(strlen(token) + 1, sizeof(char));
-      strcpy(newCommand->args[newCommand->numArgs], token);
-      newCommand->numArgs++;
+      command->args[command->numArgs] = token;
+      command->numArgs++;
+    }
+  }
+
+  // execvp() requires the last element in the arg array to be NULL
+  command->args[command->numArgs] = NULL;
+}
+
+/**
+ * This function counts the space-separated words in a string.
+ */
+static int countWords(const char* text)
+{
+  int words = 0;
+
+  for (const char* cursor = text; *cursor != '\0'; cursor++) {
+    if (*cursor != ' ' && (cursor == text || cursor[-1] == ' ')) {
+      words++;
+    }
+  }
+  return words;
+}
+
+/**
+ * This function returns 1 if the character at cursor is a "|" that stands
+ * alone as a word of text, and 0 otherwise.
+ */
+static int isPipeWord(const char* text, const char* cursor)
+{
+  return *cursor == '|' && (cursor == text || cursor[-1] == ' ')
+         && (cursor[1] == ' ' || cursor[1] == '\0');
+}
+
+/**
+ * This function returns 1 if the word at text names a launch limit without
+ * its "@", as in "nice=10", and 0 otherwise.
+ */
+static int isLimitWord(const char* text)
+{
+  return strncmp(text, "cpu=", 4) == 0 || strncmp(text, "nice=", 5) == 0
+         || strncmp(text, "mem=", 4) == 0;
+}
+
+/** 
+ * This function creates a new Command struct by parsing the command name and
+ * its arguments from a string with no particular format. The string holds a
+ * single command; pipes and the trailing "&" are handled by createPipeline().
+ * The struct, its argument array and a private copy of the string are carved
+ * out of a single allocation, so destroyCommand() is a single free().
+ * Parameters: A pointer to a character array
+ * Return value: A pointer to a structure containing the parsed command
+ */
+struct Command* createCommand(char* rawData)
+{
+  int length = strlen(rawData);
+  int numArgSlots = countWords(rawData) + 1;
+  struct Command* newCommand = malloc(sizeof(struct Command)
+                                      + numArgSlots * sizeof(char*) + length + 1);
+  char** argSpace = (char**)(newCommand + 1);
+  char* text = (char*)(argSpace + numArgSlots);
+
+  memcpy(text, rawData, length + 1);
+  parseCommand(newCommand, text, argSpace);
+	return newCommand;
+}
+
+/**
+ * This function creates a new Pipeline struct from a line of the form
+ * "a [| b ...] [&]". Each stage is parsed like a single command. A "|" only
+ * separates stages when it stands alone as a word, in the same way as "<"
+ * and ">". If the line ends in " &", every stage runs in the background, and
+ * unless redirected the first stage reads from and the last stage writes to
+ * "/dev/null".
+ * A first pass over the line counts its stages and words, so the pipeline,
+ * its stages, their argument arrays and a copy of the line can be laid out
+ * in one allocation; the line is then tokenized in place. Parsing a line
+ * therefore costs exactly one malloc(), and destroyPipeline() one free().
+ * Words at the start of the line that begin with "@" are launch modifiers
+ * such as "@cpu=0-3", "@nice=10" or "@mem=2G" (see launchLimits.c), and are
+ * stored in the pipeline's limits rather than becoming part of a stage.
+ * After the first one the "@" may be left off, as in "@cpu=0-3 nice=10".
+ * Returns NULL and prints a message if a stage is empty or a modifier is
+ * invalid.
+ */
+struct Pipeline* createPipeline(char* rawData)
+{
+  char *cursor;
+  char *stageText;
+  char **argSpace;
+  int numStages = 1;
+  int numWords = 0;
+  int stageWords = 0;
+  int runScope = 0;
+  int length = strlen(rawData);
+  struct Pipeline* newPipeline = NULL;
+  struct Command* stage = NULL;
+  struct LaunchLimits limits;
+  int sawModifier = 0;
+  size_t size;
+  char* wordEnd;
+  char saved;
+
+  /* If the last characters in the string are '&' preceded by a space, the
+   * pipeline should be run in the background, so trim the '&' and trailing
+   * space from the string
+   */
+  if (length >= 2 && strcmp(rawData + length - 2, " &") == 0) {
+    runScope = 1;
+    length -= 2;
+    rawData[length] = '\0';
+  }
+
+  // Take the launch modifiers off the front of the line
+  limitsClear(&limits);
+  while (1) {
+    while (*rawData == ' ') {
+      rawData++;
+    }
+    if (*rawData == '@') {
+      rawData++;
+    } else if (!sawModifier || !isLimitWord(rawData)) {
+      break;
+    }
+    sawModifier = 1;
+    wordEnd = strchrnul(rawData, ' ');
+    saved = *wordEnd;
+    *wordEnd = '\0';
+    if (limitsSet(&limits, rawData) == -1) {
+      *wordEnd = saved;
+      return NULL;
     }
-  }  while (token != NULL);
+    *wordEnd = saved;
+    rawData = wordEnd;
+  }
+  length = strlen(rawData);
+
+  // Count the stages and words; every stage needs at least a command name
+  for (cursor = rawData; *cursor != '\0'; cursor++) {
+    if (isPipeWord(rawData, cursor)) {
+      if (stageWords == 0) {
+        break;
+      }
+      numStages++;
+      stageWords = 0;
+    } else if (*cursor != ' ' && (cursor == rawData || cursor[-1] == ' ')) {
+      numWords++;
+      stageWords++;
+    }
+  }
+  if (stageWords == 0) {
+    printf("Error: empty command in pipeline\n");
+    fflush(stdout);
+    return NULL;
+  }
+
+  size = sizeof(struct Pipeline)
+         + numStages * (sizeof(struct Command) + sizeof(struct Command*))
+         + (numWords + numStages) * sizeof(char*)
+         + length + 1;
+  newPipeline = malloc(size);
+  stage = (struct Command*)(newPipeline + 1);
+  newPipeline->stages = (struct Command**)(stage + numStages);
+  argSpace = (char**)(newPipeline->stages + numStages);
+  stageText = (char*)(argSpace + numWords + numStages);
+  memcpy(stageText, rawData, length + 1);
+
+  newPipeline->size = size;
+  newPipeline->numStages = numStages;
+  newPipeline->runScope = runScope;
+  newPipeline->pgid = 0;
+  newPipeline->myPid = 0;
+  newPipeline->exitStatus = 0;
+  memset(&newPipeline->usage, 0, sizeof(struct rusage));
+  newPipeline->limits = limits;
+  newPipeline->captureFD = -1;
+
+  // Split the copy at each "|" and tokenize the stages in place
+  cursor = stageText;
+  for (int i = 0; i < numStages; i++) {
+    while (*cursor != '\0' && !isPipeWord(stageText, cursor)) {
+      cursor++;
+    }
+    *cursor = '\0';
+    parseCommand(stage, stageText, argSpace);
+    stage->runScope = runScope;
+    newPipeline->stages[i] = stage;
+
+    argSpace += stage->numArgs + 1;
+    stage++;
+    cursor++;
+    stageText = cursor;
+  }
 
   // For background commands without input or output redirection specified, 
   // point input and/or output to "/dev/null"
-  if (newCommand->runScope == 1) {
-    if (newCommand->inputFile == NULL) {
-      newCommand->inputFile = calloc(strlen(devNull) + 1, sizeof(char));
-      strcpy(newCommand->inputFile, devNull);
+  if (runScope == 1) {
+    stage = newPipeline->stages[0];
+    if (stage->inputFile == NULL) {
+      stage->inputFile = devNull;
     }
 
-    if (newCommand->outputFile == NULL) {
-      newCommand->outputFile = calloc(strlen(devNull) + 1, sizeof(char));
-      strcpy(newCommand->outputFile, devNull);
+    stage = newPipeline->stages[numStages - 1];
+    if (stage->outputFile == NULL) {
+      stage->outputFile = devNull;
     }
   }
 
-  // execvp() requires the last element in the arg array to be NULL
-  newCommand->args[newCommand->numArgs] = NULL;
-
-	return newCommand;
+  return newPipeline;
 }
 
 /**
@@ -118,75 +316,126 @@ void handle_SIGINT(int sigNum) {
 }
 
 /**
- *  This function takes a Command struct and an int as parameters. The int
- *  indicates if the shell is in foreground-only mode so we can set the
- *  run scope of the command appropriately.
- *  It opens input and output files if redirection was indicated in the command
- *  and then redirects stdin and stdout as appropriate.
- *  It then spawns a child process to run the command using an exec() function.
+ *  This function launches a command from the given path with posix_spawn()
+ *  instead of fork().
+ *  glibc implements posix_spawn with clone(CLONE_VM|CLONE_VFORK), so the cost
+ *  of launching does not grow with the size of the shell's address space.
+ *  Redirection is expressed as dup2 file actions on descriptors the shell
+ *  has already opened: stdFDs[i] becomes descriptor i of the child, and -1
+ *  means inherit the shell's. The process group is given as a
+ *  spawn attribute (pgid -1 means stay in the shell's group), and signal
+ *  dispositions as spawn attributes:
+ *  - SIGTSTP must be ignored by every child. Spawn attributes can only reset a
+ *    signal to its default, so the shell briefly ignores SIGTSTP itself (with
+ *    it blocked, so a ctrl-z arriving meanwhile stays pending) and the child
+ *    inherits the ignored disposition across exec.
+ *  - SIGINT is reset to its default for foreground commands; background
+ *    commands inherit the shell's ignored disposition.
+ *  Returns 0 and stores the child pid on success, or an errno value.
  */
-int executeCommand(struct Command* command, int fgOnly)
+static int spawnCommand(struct Command* command, const char* path,
+                        const int* stdFDs, pid_t pgid, pid_t* pid)
 {
-  pid_t spawnPid;
-  int inputFD, outputFD, dupResult;
-  struct sigaction SIGINT_action = {{0}};
-  struct sigaction SIGTSTP_action = {{0}};
+  posix_spawn_file_actions_t actions;
+  posix_spawnattr_t attr;
+  sigset_t blockTSTP, origMask, childMask, defaultSigs;
+  struct sigaction ignore = {{0}};
+  struct sigaction origTSTP;
+  short flags = POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF;
+  int result;
 
-  // User has forced fg-only mode, so set the runScope to match.
-  if (fgOnly == 1) {
-    command->runScope = 0;
-  }
+  posix_spawn_file_actions_init(&actions);
+  posix_spawnattr_init(&attr);
 
-  // Open file for input if applicable
-  if (command->inputFile != NULL) {
-    inputFD = open(command->inputFile, O_RDONLY);
-    if (inputFD == -1) {
-      printf("cannot open %s for input\n", command->inputFile);
-      fflush(stdout);
-      return 1;
+  for (int i = 0; i < 3; i++) {
+    if (stdFDs[i] != -1) {
+      posix_spawn_file_actions_adddup2(&actions, stdFDs[i], i);
     }
   }
+  if (pgid != -1) {
+    posix_spawnattr_setpgroup(&attr, pgid);
+    flags |= POSIX_SPAWN_SETPGROUP;
+  }
 
-  // Open file for output if applicable
-  if (command->outputFile != NULL) {
-    outputFD = open(command->outputFile, O_WRONLY | O_CREAT | O_TRUNC, 0644);
-    if (outputFD == -1) {
-      printf("cannot open %s for output\n", command->outputFile);
-      fflush(stdout);
-      return 1;
-    }
+  sigemptyset(&blockTSTP);
+  sigaddset(&blockTSTP, SIGTSTP);
+  sigprocmask(SIG_BLOCK, &blockTSTP, &origMask);
+  ignore.sa_handler = SIG_IGN;
+  sigaction(SIGTSTP, &ignore, &origTSTP);
+
+  // The child starts with the shell's original mask, less SIGCHLD which the
+  // shell keeps blocked for its signalfd, and if it is going to run in the
+  // foreground, the default SIGINT disposition
+  childMask = origMask;
+  sigdelset(&childMask, SIGCHLD);
+  sigemptyset(&defaultSigs);
+  if (command->runScope == 0) {
+    sigaddset(&defaultSigs, SIGINT);
   }
+  posix_spawnattr_setsigmask(&attr, &childMask);
+  posix_spawnattr_setsigdefault(&attr, &defaultSigs);
+  posix_spawnattr_setflags(&attr, flags);
+
+  result = posix_spawn(pid, path, &actions, &attr, command->args, environ);
+
+  sigaction(SIGTSTP, &origTSTP, NULL);
+  sigprocmask(SIG_SETMASK, &origMask, NULL);
+
+  posix_spawnattr_destroy(&attr);
+  posix_spawn_file_actions_destroy(&actions);
+  return result;
+}
+
+/**
+ *  This function launches a command from the given path the traditional way:
+ *  fork() the shell, then redirect, apply the launch limits, set up signal
+ *  handling and exec in the child. It is used when there are limits to
+ *  apply, and as a fallback when posix_spawn is unavailable.
+ *  Returns 0 and stores the child pid on success, or an errno value.
+ */
+static int forkCommand(struct Command* command, const char* path,
+                       const int* stdFDs, pid_t pgid,
+                       const struct LaunchLimits* limits, pid_t* pid)
+{
+  pid_t spawnPid;
+  int dupResult;
+  sigset_t chldMask;
+  struct sigaction SIGINT_action = {{0}};
+  struct sigaction SIGTSTP_action = {{0}};
 
-  // Fork the shell and store the child pid in the command struct
   spawnPid = fork();
   switch (spawnPid) {
     case -1:
       // Fork failed
-      perror("Unable to fork process\n");
-      fflush(stdout);
-      return 1;
-      break;
+      return errno;
     case 0:
       // This is what the child is doing
-      // Redirect input if applicable
-      if (command->inputFile != NULL) {
-        dupResult = dup2(inputFD, 0);
-        if (dupResult == -1) {
-          perror("Input redirect");
-          fflush(stdout);
-          exit(1);
-        }
+      // The shell keeps SIGCHLD blocked for its signalfd; the command should not
+      sigemptyset(&chldMask);
+      sigaddset(&chldMask, SIGCHLD);
+      sigprocmask(SIG_UNBLOCK, &chldMask, NULL);
+
+      if (pgid != -1) {
+        setpgid(0, pgid);
       }
-      // Redirect output if applicable
-      if (command->outputFile != NULL) {
-        dupResult = dup2(outputFD, 1);
-        if (dupResult == -1) {
-          perror("Output redirect");
-          fflush(stdout);
-          exit(1);
+
+      // Redirect input, output and errors if applicable
+      for (int i = 0; i < 3; i++) {
+        if (stdFDs[i] != -1) {
+          dupResult = dup2(stdFDs[i], i);
+          if (dupResult == -1) {
+            perror("Redirect");
+            fflush(stdout);
+            exit(1);
+          }
         }
       }
 
+      if (limitsApply(limits) == -1) {
+        fflush(stdout);
+        exit(1);
+      }
+
       // Any forground or background commands should ignore SIGTSTP
       SIGTSTP_action.sa_handler = SIG_IGN;
       sigfillset(&SIGTSTP_action.sa_mask);
@@ -201,28 +450,13 @@ int executeCommand(struct Command* command, int fgOnly)
         SIGINT_action.sa_flags = SA_RESTART;
         sigaction(SIGINT, &SIGINT_action, NULL);
       }
-      execvp(command->name, command->args);
+      execv(path, command->args);
       fflush(NULL);
       perror(command->name);
       fflush(stdout);
       exit(1);
-      break;
     default:
-      if (command->runScope == 1) {
-      // If running in the background, return control to user prompt
-        printf("background pid is %d\n", spawnPid);
-        fflush(stdout);
-        command->myPid = spawnPid;
-      } else {
-      // Otherwise wait for process to terminate before returning control
-        spawnPid = waitpid(spawnPid, &command->exitStatus, 0);
-        fflush(NULL);
-        if (WIFEXITED(command->exitStatus)) {
-          return WEXITSTATUS(command->exitStatus);
-        } else {
-          return WTERMSIG(command->exitStatus);
-        }
-      }
+      *pid = spawnPid;
       break;
   }
 
@@ -230,24 +464,410 @@ int executeCommand(struct Command* command, int fgOnly)
 }
 
 /**
- *  This function takes a Command struct as a parameter and frees up the memory
- *  allocated to hold the members of the struct.
+ *  This function launches a command from the given path, which is NULL if
+ *  the command could not be found. A command with launch limits is forked,
+ *  since neither posix_spawn nor the zygote can apply them. Otherwise, if
+ *  the zygote is running it is asked to launch the command; if not, the
+ *  shell spawns it, falling back to fork() only if this system cannot
+ *  posix_spawn at all.
+ *  Returns 0 and stores the child pid in the command, or an errno value.
  */
-void destroyCommand(struct Command* command) 
+static int startChild(struct Command* command, const char* path,
+                      const int* stdFDs, pid_t pgid, const struct LaunchLimits* limits)
 {
-  if (command->name != NULL) {
-  free(command->name);
+  int result;
+
+  if (path == NULL) {
+    return ENOENT;
   }
+  if (!limitsEmpty(limits)) {
+    return forkCommand(command, path, stdFDs, pgid, limits, &command->myPid);
+  }
+  if (zygoteRunning()) {
+    result = zygoteSpawn(path, command->args, command->runScope == 0, stdFDs,
+                         pgid, &command->myPid);
+    if (result != -1) {
+      return result;
+    }
+  }
+  result = spawnCommand(command, path, stdFDs, pgid, &command->myPid);
+  if (result == ENOSYS || result == EINVAL) {
+    result = forkCommand(command, path, stdFDs, pgid, limits, &command->myPid);
+  }
+  return result;
+}
+
+/**
+ *  This function opens a redirection file for a stage, close-on-exec so
+ *  that only the child's dup2() copy survives into any program.
+ *  Returns the descriptor, or -1 after printing why it could not be opened.
+ */
+static int openRedirect(const char* fileName, int flags, const char* what)
+{
+  int fd = open(fileName, flags | O_CLOEXEC, 0644);
+
+  if (fd == -1) {
+    printf("cannot open %s for %s\n", fileName, what);
+    fflush(stdout);
+  }
+  return fd;
+}
+
+/**
+ *  This function launches one stage of a pipeline. The stage's own "<", ">",
+ *  ">>" and "2>" redirections take precedence over the descriptors it is
+ *  given for stdin, stdout and stderr (-1 means inherit the shell's), and "2>&1" points stderr at
+ *  wherever stdout ends up. The shell's copies of the files it opens are
+ *  closed as soon as the child has been launched, so the shell holds no
+ *  descriptors for a running command; the pipe ends are left to the caller.
+ *  The child is started under the given launch limits.
+ *  Returns 0 and stores the child pid on success, or 1 after printing why
+ *  the stage could not be launched.
+ */
+static int launchStage(struct Command* command, int inputFD, int outputFD, int errorFD,
+                       pid_t pgid, const struct LaunchLimits* limits)
+{
+  int fileFDs[3] = {-1, -1, -1};
+  int stdFDs[3] = {inputFD, outputFD, errorFD};
+  int outputFlags = O_WRONLY | O_CREAT | (command->appendOutput ? O_APPEND : O_TRUNC);
+  int result = 0;
+  int cached;
+  struct timespec spawnStart;
+
+  // Open the files for input, output and errors if applicable
   if (command->inputFile != NULL) {
-    free(command->inputFile);
+    fileFDs[0] = openRedirect(command->inputFile, O_RDONLY, "input");
+    result |= fileFDs[0] == -1;
+  }
+  if (result == 0 && command->outputFile != NULL) {
+    fileFDs[1] = openRedirect(command->outputFile, outputFlags, "output");
+    result |= fileFDs[1] == -1;
+  }
+  if (result == 0 && command->errorFile != NULL) {
+    fileFDs[2] = openRedirect(command->errorFile, O_WRONLY | O_CREAT | O_TRUNC, "errors");
+    result |= fileFDs[2] == -1;
+  }
+
+  if (result == 0) {
+    for (int i = 0; i < 3; i++) {
+      if (fileFDs[i] != -1) {
+        stdFDs[i] = fileFDs[i];
+      }
+    }
+    if (command->errorToOutput) {
+      stdFDs[2] = stdFDs[1] != -1 ? stdFDs[1] : STDOUT_FILENO;
+    }
+
+    // Launch the child and store its pid in the command struct. If a path
+    // that came from the cache no longer executes, forget it and search PATH
+    // once more; a path that was just searched for is not searched again.
+    fflush(NULL);
+    TRACE_BEGIN(TRACE_SPAWN);
+    clock_gettime(CLOCK_MONOTONIC, &spawnStart);
+    result = startChild(command, pathCacheLookup(command->name, &cached), stdFDs, pgid, limits);
+    if (cached && (result == ENOENT || result == EACCES || result == ENOEXEC)) {
+      pathCacheForget(command->name);
+      result = startChild(command, pathCacheLookup(command->name, &cached), stdFDs, pgid, limits);
+    }
+    metricsCountSpawn(&spawnStart, result != 0);
+    TRACE_END(TRACE_SPAWN, result == 0 ? command->myPid : 0);
+    if (result != 0) {
+      // The child could not be created, or the program could not be executed
+      errno = result;
+      perror(command->name);
+      fflush(stdout);
+      result = 1;
+    }
+  }
+
+  for (int i = 0; i < 3; i++) {
+    if (fileFDs[i] != -1) {
+      close(fileFDs[i]);
+    }
+  }
+  if (result != 0) {
+    command->myPid = 0;
+  }
+  return result;
+}
+
+/**
+ *  This function kills and reaps the first numStarted stages of a pipeline
+ *  that cannot be finished, so that none of them is left running with
+ *  nothing to read from or write to, or left as a zombie.
+ */
+static void abandonStages(struct Pipeline* pipeline, int numStarted)
+{
+  struct Command* stage = NULL;
+  int status;
+
+  for (int i = 0; i < numStarted; i++) {
+    stage = pipeline->stages[i];
+    if (stage->myPid != 0) {
+      kill(stage->myPid, SIGKILL);
+      waitChild(stage->myPid, &status, NULL);
+      stage->myPid = 0;
+    }
+  }
+}
+
+/**
+ *  This function launches every stage of a pipeline without waiting for any
+ *  of them, and records the pid of the last stage in the pipeline.
+ *  Adjacent stages are connected with pipe2(O_CLOEXEC), so each child only
+ *  keeps the two ends dup2()ed onto its stdin and stdout. If the
+ *  SMALLSH_PIPE_SIZE environment variable is set, each pipe's buffer is
+ *  resized to that many bytes with F_SETPIPE_SZ.
+ *  A background pipeline is put into its own process group, led by its first
+ *  stage, so the whole job can be signalled at once. Foreground stages stay
+ *  in the shell's process group, which is the one the terminal sends ctrl-c
+ *  to.
+ *  If the pipeline has a capture descriptor, the output the last stage would
+ *  have sent to /dev/null goes there instead, and so does stderr of every
+ *  stage that does not redirect it. The descriptor is left to the caller.
+ *  If a pipe cannot be made, the stages already started are killed and
+ *  reaped, and the pipeline fails as if its last stage could not be
+ *  launched.
+ *  Returns 0, or 1 if the last stage could not be launched, in which case
+ *  the pipeline's status is set as if it had exited with 1.
+ */
+int launchPipeline(struct Pipeline* pipeline)
+{
+  struct Command* stage = NULL;
+  char* pipeSizeStr = getenv("SMALLSH_PIPE_SIZE");
+  int pipeSize = pipeSizeStr != NULL ? atoi(pipeSizeStr) : 0;
+  int pipeFDs[2];
+  int inputFD = -1;
+  int outputFD = -1;
+  int errorFD = pipeline->captureFD;
+  int lastFailed = 0;
+  pid_t pgid = -1;
+
+  if (pipeline->runScope == 1) {
+    pgid = 0;   // The first stage leads a new process group
+  }
+  clock_gettime(CLOCK_MONOTONIC, &pipeline->startTime);
+  pipeline->endTime.tv_sec = 0;
+  pipeline->endTime.tv_nsec = 0;
+
+  for (int i = 0; i < pipeline->numStages; i++) {
+    stage = pipeline->stages[i];
+    stage->runScope = pipeline->runScope;
+
+    outputFD = -1;
+    if (i < pipeline->numStages - 1) {
+      if (pipe2(pipeFDs, O_CLOEXEC) == -1) {
+        perror("pipe");
+        fflush(stdout);
+        if (inputFD != -1) {
+          close(inputFD);
+        }
+        abandonStages(pipeline, i);
+        stage->myPid = 0;
+        lastFailed = 1;
+        break;
+      }
+      if (pipeSize > 0) {
+        fcntl(pipeFDs[1], F_SETPIPE_SZ, pipeSize);
+      }
+      outputFD = pipeFDs[1];
+    } else if (pipeline->captureFD != -1 && stage->outputFile == devNull) {
+      stage->outputFile = NULL;
+      outputFD = pipeline->captureFD;
+    }
+
+    lastFailed = launchStage(stage, inputFD, outputFD, errorFD, pgid, &pipeline->limits);
+    if (lastFailed == 0 && pgid == 0) {
+      pgid = stage->myPid;
+      pipeline->pgid = pgid;
+    }
+
+    // The child has its own copies now; keep only the next stage's input
+    if (inputFD != -1) {
+      close(inputFD);
+    }
+    if (outputFD != -1 && outputFD != pipeline->captureFD) {
+      close(outputFD);
+      inputFD = pipeFDs[0];
+    }
+  }
+
+  pipeline->myPid = stage->myPid;
+  if (lastFailed) {
+    pipeline->exitStatus = 1 << 8;
+  }
+  return lastFailed;
+}
+
+/**
+ *  The event loop handler for the pidfd of a child being waited for.
+ */
+static void onChildExited(int fd, void* data)
+{
+  *(int*)data = 1;
+}
+
+/**
+ *  This function waits for the given child to exit and collects its status
+ *  and, unless usage is NULL, its resource usage with wait4(). While the
+ *  event loop is watching anything, such as the control socket or the
+ *  pipes of captured output, it is served until the child exits, which is
+ *  seen through a pidfd; otherwise the shell just blocks in wait4().
+ *  Returns the pid, or -1 if it is not a child of the shell.
+ */
+pid_t waitChild(pid_t pid, int* status, struct rusage* usage)
+{
+  int exited = 0;
+  int pidFD = -1;
+
+  if (eventLoopWatching() > 0) {
+    pidFD = syscall(SYS_pidfd_open, pid, 0);
+  }
+  if (pidFD != -1 && eventLoopAdd(pidFD, onChildExited, &exited) == 0) {
+    // SIGTSTP interrupts the wait; just go back to waiting
+    while (!exited) {
+      if (eventLoopWait(-1) == -1 && errno != EINTR) {
+        break;
+      }
+    }
+    eventLoopRemove(pidFD);
   }
-  if (command->outputFile != NULL) {
-    free(command->outputFile);
+  if (pidFD != -1) {
+    close(pidFD);
   }
-  if (command->numArgs > 0) {
-    for (int i = command->numArgs; i >= 0; i--) {
-      free(command->args[i]);
+  return wait4(pid, status, 0, usage);
+}
+
+/**
+ *  This function takes a Pipeline struct and an int as parameters. The int
+ *  indicates if the shell is in foreground-only mode so we can set the
+ *  run scope of the pipeline appropriately.
+ *  It launches the pipeline, then either reports the pid of a background
+ *  pipeline or waits for every stage of a foreground one with waitChild(),
+ *  collecting their resource usage.
+ *  Returns the exit value (or terminating signal) of the last stage for a
+ *  foreground pipeline, or 0 once a background pipeline has been launched.
+ *  A stage that cannot be launched counts as having exited with 1.
+ */
+int executePipeline(struct Pipeline* pipeline, int fgOnly)
+{
+  struct Command* stage = NULL;
+  struct rusage usage;
+  int lastFailed;
+
+  // User has forced fg-only mode, so set the runScope to match.
+  if (fgOnly == 1) {
+    pipeline->runScope = 0;
+  }
+
+  lastFailed = launchPipeline(pipeline);
+
+  if (pipeline->runScope == 1) {
+  // If running in the background, return control to user prompt
+    if (lastFailed) {
+      return 1;
     }
+    printf("background pid is %d\n", pipeline->myPid);
+    fflush(stdout);
+    return 0;
   }
+
+  // Otherwise wait for every stage to terminate before returning control;
+  // the status of the pipeline is that of its last stage
+  for (int i = 0; i < pipeline->numStages; i++) {
+    stage = pipeline->stages[i];
+    if (stage->myPid != 0) {
+      TRACE_BEGIN(TRACE_WAIT);
+      waitChild(stage->myPid, &stage->exitStatus, &usage);
+      TRACE_END(TRACE_WAIT, stage->myPid);
+      pipelineAddUsage(pipeline, &usage);
+    }
+  }
+  fflush(NULL);
+  if (!lastFailed) {
+    pipeline->exitStatus = stage->exitStatus;
+  }
+  if (WIFEXITED(pipeline->exitStatus)) {
+    return WEXITSTATUS(pipeline->exitStatus);
+  } else {
+    return WTERMSIG(pipeline->exitStatus);
+  }
+}
+
+/**
+ *  This function adds the resource usage of a stage reported by wait4() to
+ *  the pipeline's totals and marks the time. CPU times, faults, block I/O
+ *  and context switches are summed over the stages, and the maximum RSS is
+ *  that of the largest stage. Each stage of a foreground pipeline is counted
+ *  as reaped here; background jobs are counted by jobFinished().
+ */
+void pipelineAddUsage(struct Pipeline* pipeline, const struct rusage* usage)
+{
+  struct rusage* total = &pipeline->usage;
+
+  metricsCountReap();
+
+  timeradd(&total->ru_utime, &usage->ru_utime, &total->ru_utime);
+  timeradd(&total->ru_stime, &usage->ru_stime, &total->ru_stime);
+  if (usage->ru_maxrss > total->ru_maxrss) {
+    total->ru_maxrss = usage->ru_maxrss;
+  }
+  total->ru_minflt += usage->ru_minflt;
+  total->ru_majflt += usage->ru_majflt;
+  total->ru_inblock += usage->ru_inblock;
+  total->ru_oublock += usage->ru_oublock;
+  total->ru_nvcsw += usage->ru_nvcsw;
+  total->ru_nivcsw += usage->ru_nivcsw;
+  clock_gettime(CLOCK_MONOTONIC, &pipeline->endTime);
+}
+
+/**
+ *  This function returns the wall-clock time in seconds from the launch of
+ *  the pipeline to the reaping of its last stage, or until now if it is
+ *  still running.
+ */
+double pipelineElapsed(struct Pipeline* pipeline)
+{
+  struct timespec end = pipeline->endTime;
+
+  if (end.tv_sec == 0 && end.tv_nsec == 0) {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+  }
+  return (end.tv_sec - pipeline->startTime.tv_sec)
+         + (end.tv_nsec - pipeline->startTime.tv_nsec) / 1e9;
+}
+
+/**
+ *  This function runs a single command as a one-stage pipeline. It takes the
+ *  same foreground-only flag and returns the same value as executePipeline().
+ */
+int executeCommand(struct Command* command, int fgOnly)
+{
+  struct Command* stages[1] = {command};
+  // Everything else starts out as createPipeline() leaves it
+  struct Pipeline pipeline = {.stages = stages, .numStages = 1,
+                              .runScope = command->runScope, .captureFD = -1};
+  int result = executePipeline(&pipeline, fgOnly);
+
+  command->runScope = pipeline.runScope;
+  command->exitStatus = pipeline.exitStatus;
+  return result;
+}
+
+/**
+ *  This function takes a Command struct created by createCommand() and frees
+ *  the single allocation that holds it, its arguments and their text.
+ */
+void destroyCommand(struct Command* command) 
+{
   free(command);
 }
+
+/**
+ *  This function takes a Pipeline struct and frees the single allocation
+ *  that holds it and all of its stages.
+ */
+void destroyPipeline(struct Pipeline* pipeline)
+{
+  free(pipeline);
+}
@@ -2,35 +2,66 @@
  * Filename: command.h
  * Author: Aaron Ennis
  * Email: ennisa@oregonstate.edu
- * Last modified: 31 October 2020
+ * Last modified: 16 October 2026
  * Description: This is the declaration/interface file that defines a structure
  * to contain information about a command, and some simple functions to
  * operate on the structure.
  */
 
 #include <sys/types.h>
+#include <sys/resource.h>
 #include <unistd.h>
+#include <time.h>
 
 
 #ifndef COMMAND_H
 #define COMMAND_H
 #include <signal.h>
+#include "launchLimits.h"
 
 // Define the command struct
 struct Command
 {
   char* name;
-  char* args[512];
+  char** args;  // NULL-terminated, as required by execvp()
   char* inputFile;
   char* outputFile;
+  char* errorFile;
+  int appendOutput;   // ">>" rather than ">"
+  int errorToOutput;  // "2>&1"
   int numArgs;
   int exitStatus;
   pid_t myPid;
   int runScope; // 0 = foreground, 1 = background
 };
 
+// A line of one or more commands connected by "|"
+struct Pipeline
+{
+  struct Command** stages;
+  int numStages;
+  int runScope; // 0 = foreground, 1 = background
+  pid_t pgid;   // Process group of a background pipeline
+  pid_t myPid;  // The last stage, whose status is the pipeline's
+  int exitStatus;
+  struct timespec startTime;  // When the pipeline was launched
+  struct timespec endTime;    // When its last stage was reaped
+  struct rusage usage;        // Summed over the stages reaped so far
+  struct LaunchLimits limits; // From its "@" modifiers, applied to each stage
+  size_t size;  // Bytes in its single allocation, stages and words included
+  int captureFD; // Where background output goes instead of /dev/null, or -1
+};
+
 struct Command* createCommand(char* rawData);
 void destroyCommand(struct Command* command);
 int executeCommand(struct Command* command, int fgOnly);
 
+struct Pipeline* createPipeline(char* rawData);
+void destroyPipeline(struct Pipeline* pipeline);
+int launchPipeline(struct Pipeline* pipeline);
+int executePipeline(struct Pipeline* pipeline, int fgOnly);
+void pipelineAddUsage(struct Pipeline* pipeline, const struct rusage* usage);
+double pipelineElapsed(struct Pipeline* pipeline);
+pid_t waitChild(pid_t pid, int* status, struct rusage* usage);
+
 #endif
\ No newline at end of file
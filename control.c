@@ -0,0 +1,306 @@
+/*
+ * Filename: control.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the control socket. With
+ * SMALLSH_CONTROL set to a path, the shell listens on a Unix domain socket
+ * there. A client writes one query per line and gets one line of JSON back:
+ *
+ *   jobs      {"jobs":[{"id":1,"pid":123,"command":"sleep 10 &",
+ *              "runtime":1.25,"state":"running"},...]}
+ *   metrics   {"pid":100,"jobs":1,"spawns":..,"spawn_failures":..,
+ *              "reaps":..,"parses":..,"parse_seconds":..,
+ *              "spawn_latency_us":{"count":..,"sum":..,
+ *              "buckets":[[1,n],[2,n],...]}}
+ *
+ * A job's state is "done" once it has exited but not yet been reaped. Each
+ * bucket of the latency histogram is given as [upper bound, count], with
+ * empty buckets left out.
+ *
+ * The listening socket and the clients are served by the shell's event
+ * loop, so queries are answered between lines, while the shell waits for
+ * input, whether from a terminal or a pipe, and while it waits for a
+ * foreground command or in "wait". Replies are written with a one second timeout;
+ * a client that does not read its reply in time is disconnected.
+ */
+
+#define _GNU_SOURCE   // accept4()
+#include "control.h"
+#include "eventLoop.h"
+#include "expand.h"
+#include "metrics.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+#define QUERY_MAX 256
+
+struct Client
+{
+  int fd;
+  size_t length;          // Bytes of an unfinished query in the buffer
+  char buffer[QUERY_MAX];
+};
+
+static int listenFD = -1;
+static char* socketPath = NULL;
+static struct JobTable* jobTable = NULL;
+static struct Expansion reply;    // Reused for every reply
+
+/**
+ * Appends formatted text to the reply.
+ */
+static void replyPrintf(const char* format, ...)
+{
+  char text[256];
+  va_list args;
+  int length;
+
+  va_start(args, format);
+  length = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+  if (length >= (int)sizeof(text)) {
+    length = sizeof(text) - 1;
+  }
+  expansionAppend(&reply, text, length);
+}
+
+/**
+ * Appends a word to the reply as part of a JSON string, escaping quotes,
+ * backslashes and control characters.
+ */
+static void replyString(const char* text)
+{
+  const char* run = text;
+
+  for (; *text != '\0'; text++) {
+    if (*text == '"' || *text == '\\' || (unsigned char)*text < 0x20) {
+      expansionAppend(&reply, run, text - run);
+      replyPrintf("\\u%04x", (unsigned char)*text);
+      run = text + 1;
+    }
+  }
+  expansionAppend(&reply, run, text - run);
+}
+
+/**
+ * Builds the reply to "jobs".
+ */
+static void replyJobs()
+{
+  struct Job* job = NULL;
+  siginfo_t info;
+  int first = 1;
+
+  replyPrintf("{\"jobs\":[");
+  for (int id = 1; id <= jobTableMaxId(jobTable); id++) {
+    job = jobTableFindId(jobTable, id);
+    if (job == NULL) {
+      continue;
+    }
+    // WNOWAIT looks at the child without reaping it
+    info.si_pid = 0;
+    waitid(P_PID, job->pid, &info, WEXITED | WNOHANG | WNOWAIT);
+
+    replyPrintf("%s{\"id\":%d,\"pid\":%d,\"command\":\"", first ? "" : ",", job->id, job->pid);
+    replyString(job->command);
+    replyPrintf(" &\",\"runtime\":%.3f,\"state\":\"%s\"}", jobElapsed(job),
+                info.si_pid != 0 ? "done" : "running");
+    first = 0;
+  }
+  replyPrintf("]}\n");
+}
+
+/**
+ * Builds the reply to "metrics".
+ */
+static void replyMetrics()
+{
+  const struct Metrics* metrics = metricsGet();
+  const struct Histogram* latency = &metrics->spawnLatency;
+  int first = 1;
+
+  replyPrintf("{\"pid\":%d,\"jobs\":%d,\"spawns\":%lu,\"spawn_failures\":%lu,"
+              "\"reaps\":%lu,\"parses\":%lu,\"parse_seconds\":%.6f,",
+              getpid(), jobTableSize(jobTable), metrics->spawns, metrics->spawnFailures,
+              metrics->reaps, metrics->parses, metrics->parseSeconds);
+  replyPrintf("\"spawn_latency_us\":{\"count\":%lu,\"sum\":%.1f,\"buckets\":[",
+              latency->count, latency->sumMicros);
+  for (int i = 0; i < METRICS_BUCKETS; i++) {
+    if (latency->counts[i] > 0) {
+      replyPrintf("%s[%lu,%lu]", first ? "" : ",", 1UL << i, latency->counts[i]);
+      first = 0;
+    }
+  }
+  replyPrintf("]}}\n");
+}
+
+/**
+ * Disconnects a client.
+ */
+static void closeClient(struct Client* client)
+{
+  eventLoopRemove(client->fd);
+  close(client->fd);
+  free(client);
+}
+
+/**
+ * Answers one query.
+ * Returns 0, or -1 if the reply could not be written.
+ */
+static int answer(struct Client* client, const char* query)
+{
+  size_t written = 0;
+  ssize_t count;
+
+  reply.length = 0;
+  if (strcmp(query, "jobs") == 0) {
+    replyJobs();
+  } else if (strcmp(query, "metrics") == 0) {
+    replyMetrics();
+  } else if (query[0] == '\0') {
+    return 0;
+  } else {
+    replyPrintf("{\"error\":\"unknown query\",\"queries\":[\"jobs\",\"metrics\"]}\n");
+  }
+
+  while (written < reply.length) {
+    count = send(client->fd, reply.text + written, reply.length - written, MSG_NOSIGNAL);
+    if (count == -1 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      return -1;
+    }
+    written += count;
+  }
+  return 0;
+}
+
+/**
+ * The event loop handler for a client: reads what it has sent and answers
+ * each whole line. A client whose query is longer than QUERY_MAX, or that
+ * has hung up, is disconnected.
+ */
+static void onClientReadable(int fd, void* data)
+{
+  struct Client* client = data;
+  ssize_t count;
+  char* line;
+  char* newline;
+
+  count = read(fd, client->buffer + client->length, sizeof(client->buffer) - client->length);
+  if (count <= 0) {
+    if (count == -1 && errno == EINTR) {
+      return;
+    }
+    closeClient(client);
+    return;
+  }
+  client->length += count;
+
+  line = client->buffer;
+  while ((newline = memchr(line, '\n', client->buffer + client->length - line)) != NULL) {
+    *newline = '\0';
+    if (newline > line && newline[-1] == '\r') {
+      newline[-1] = '\0';
+    }
+    if (answer(client, line) == -1) {
+      closeClient(client);
+      return;
+    }
+    line = newline + 1;
+  }
+  client->length -= line - client->buffer;
+  if (client->length == sizeof(client->buffer)) {
+    closeClient(client);
+    return;
+  }
+  memmove(client->buffer, line, client->length);
+}
+
+/**
+ * The event loop handler for the listening socket: accepts a client.
+ */
+static void onConnect(int fd, void* data)
+{
+  struct timeval timeout = {1, 0};
+  struct Client* client;
+  int clientFD = accept4(fd, NULL, NULL, SOCK_CLOEXEC);
+
+  if (clientFD == -1) {
+    return;
+  }
+  setsockopt(clientFD, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  client = malloc(sizeof(struct Client));
+  assert(client != 0);
+  client->fd = clientFD;
+  client->length = 0;
+  if (eventLoopAdd(clientFD, onClientReadable, client) == -1) {
+    close(clientFD);
+    free(client);
+  }
+}
+
+/**
+ *  This function starts listening for queries about the given job table on
+ *  a Unix domain socket at path, replacing any socket already there.
+ *  Returns 0, or -1 after printing why the socket could not be created.
+ */
+int controlStart(const char* path, struct JobTable* jobs)
+{
+  struct sockaddr_un address;
+
+  if (strlen(path) >= sizeof(address.sun_path)) {
+    printf("control socket path is too long: %s\n", path);
+    fflush(stdout);
+    return -1;
+  }
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  strcpy(address.sun_path, path);
+
+  listenFD = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (listenFD == -1) {
+    perror("control socket");
+    return -1;
+  }
+  unlink(path);
+  if (bind(listenFD, (struct sockaddr*)&address, sizeof(address)) == -1
+      || listen(listenFD, 16) == -1
+      || eventLoopAdd(listenFD, onConnect, NULL) == -1) {
+    perror("control socket");
+    close(listenFD);
+    listenFD = -1;
+    return -1;
+  }
+
+  socketPath = strdup(path);
+  jobTable = jobs;
+  expansionInit(&reply);
+  return 0;
+}
+
+/**
+ *  This function stops listening and removes the socket. Clients that are
+ *  still connected are left to be closed when the shell exits.
+ */
+void controlStop()
+{
+  if (listenFD == -1) {
+    return;
+  }
+  eventLoopRemove(listenFD);
+  close(listenFD);
+  listenFD = -1;
+  unlink(socketPath);
+  free(socketPath);
+  expansionFree(&reply);
+}
@@ -0,0 +1,17 @@
+/*
+ * Filename: control.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the control
+ * socket, a Unix domain socket on which other programs can query the
+ * shell's job table and counters while it runs.
+ */
+
+#ifndef CONTROL_H
+#define CONTROL_H
+
+#include "jobTable.h"
+
+int controlStart(const char* path, struct JobTable* jobs);
+void controlStop();
+
+#endif
@@ -0,0 +1,114 @@
+/*
+ * Filename: eventLoop.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the shell's event loop.
+ * Each watched descriptor has a handler, which is called whenever the
+ * descriptor is readable (or has hung up) while the shell waits in
+ * eventLoopWait(). Descriptors are watched level-triggered, so a handler
+ * that leaves data unread is simply called again on the next wait.
+ */
+
+#include "eventLoop.h"
+#include <assert.h>
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+
+#define MAX_EVENTS 32
+
+struct Watch
+{
+  EventHandler handler;
+  void* data;
+};
+
+static int epollFD = -1;
+static struct Watch* watches = NULL;  // Indexed by descriptor
+static int numWatches = 0;
+static int numWatched = 0;    // Descriptors being watched
+
+/**
+ *  This function starts watching the given descriptor for input.
+ *  Returns 0, or -1 if it cannot be watched.
+ */
+int eventLoopAdd(int fd, EventHandler handler, void* data)
+{
+  struct epoll_event event;
+  int oldNumWatches = numWatches;
+
+  if (epollFD == -1) {
+    epollFD = epoll_create1(EPOLL_CLOEXEC);
+    if (epollFD == -1) {
+      return -1;
+    }
+  }
+  if (fd >= numWatches) {
+    numWatches = fd < 16 ? 32 : 2 * fd;
+    watches = realloc(watches, numWatches * sizeof(struct Watch));
+    assert(watches != 0);
+    memset(watches + oldNumWatches, 0, (numWatches - oldNumWatches) * sizeof(struct Watch));
+  }
+
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN;
+  event.data.fd = fd;
+  if (epoll_ctl(epollFD, EPOLL_CTL_ADD, fd, &event) == -1) {
+    return -1;
+  }
+  watches[fd].handler = handler;
+  watches[fd].data = data;
+  numWatched++;
+  return 0;
+}
+
+/**
+ * Stops watching the given descriptor. This must be done before it is
+ * closed.
+ */
+void eventLoopRemove(int fd)
+{
+  if (fd < numWatches && watches[fd].handler != NULL) {
+    epoll_ctl(epollFD, EPOLL_CTL_DEL, fd, NULL);
+    watches[fd].handler = NULL;
+    numWatched--;
+  }
+}
+
+/**
+ * Returns the number of descriptors being watched.
+ */
+int eventLoopWatching()
+{
+  return numWatched;
+}
+
+/**
+ *  This function waits up to timeout milliseconds (-1 for no limit, 0 to
+ *  just look) for watched descriptors to become ready, and calls their
+ *  handlers. A handler may add and remove watches, including its own.
+ *  Returns the number of handlers called, or -1 if the wait failed, for
+ *  example with EINTR because a signal arrived.
+ */
+int eventLoopWait(int timeout)
+{
+  struct epoll_event events[MAX_EVENTS];
+  int numReady;
+  int called = 0;
+  int fd;
+
+  if (epollFD == -1) {
+    return 0;
+  }
+  numReady = epoll_wait(epollFD, events, MAX_EVENTS, timeout);
+  for (int i = 0; i < numReady; i++) {
+    fd = events[i].data.fd;
+    // An earlier handler may have removed this watch
+    if (fd < numWatches && watches[fd].handler != NULL) {
+      watches[fd].handler(fd, watches[fd].data);
+      called++;
+    }
+  }
+  return numReady == -1 ? -1 : called;
+}
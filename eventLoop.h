@@ -0,0 +1,20 @@
+/*
+ * Filename: eventLoop.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the shell's event
+ * loop, which waits on every descriptor the shell is interested in with a
+ * single epoll set and calls a handler for each one that is ready. Like the
+ * path cache, there is one event loop for the whole process.
+ */
+
+#ifndef EVENT_LOOP_H
+#define EVENT_LOOP_H
+
+typedef void (*EventHandler)(int fd, void* data);
+
+int eventLoopAdd(int fd, EventHandler handler, void* data);
+void eventLoopRemove(int fd);
+int eventLoopWatching();
+int eventLoopWait(int timeout);
+
+#endif
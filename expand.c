@@ -0,0 +1,171 @@
+/*
+ * Filename: expand.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for variable expansion of
+ * command lines. The source is scanned for "$" with memchr() and the text
+ * between them is copied in bulk into an output buffer that grows as
+ * needed, so a line is expanded in a single pass whatever its length.
+ *
+ *   $$         the shell's pid
+ *   $?         the status of the last foreground command
+ *   $!         the pid of the last background command
+ *   $NAME      the loop variable NAME, or else the environment variable
+ *              NAME, or nothing if it is unset
+ *   ${NAME}    the same, for when a name character follows
+ *
+ * A "$" followed by anything else is left as it is.
+ */
+
+#include "expand.h"
+#include <assert.h>
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define INITIAL_CAPACITY 256
+
+/**
+ * Sets up an empty output buffer.
+ */
+void expansionInit(struct Expansion* out)
+{
+  out->text = NULL;
+  out->length = 0;
+  out->capacity = 0;
+}
+
+/**
+ * Frees the output buffer's memory.
+ */
+void expansionFree(struct Expansion* out)
+{
+  free(out->text);
+  expansionInit(out);
+}
+
+/**
+ * Appends the given bytes to the output, doubling the buffer until they fit
+ * along with a null terminator.
+ */
+static void append(struct Expansion* out, const char* text, size_t length)
+{
+  if (out->length + length + 1 > out->capacity) {
+    if (out->capacity == 0) {
+      out->capacity = INITIAL_CAPACITY;
+    }
+    while (out->length + length + 1 > out->capacity) {
+      out->capacity *= 2;
+    }
+    out->text = realloc(out->text, out->capacity);
+    assert(out->text != 0);
+  }
+  memcpy(out->text + out->length, text, length);
+  out->length += length;
+}
+
+/**
+ * Appends the given bytes to the output as they are, keeping it
+ * null-terminated.
+ */
+void expansionAppend(struct Expansion* out, const char* text, size_t length)
+{
+  append(out, text, length);
+  out->text[out->length] = '\0';
+}
+
+/**
+ * Returns the length of the variable name at the start of the given text,
+ * or 0 if it does not start with one.
+ */
+static size_t nameLength(const char* text)
+{
+  size_t length = 0;
+
+  if (!isalpha((unsigned char)text[0]) && text[0] != '_') {
+    return 0;
+  }
+  while (isalnum((unsigned char)text[length]) || text[length] == '_') {
+    length++;
+  }
+  return length;
+}
+
+/**
+ * Appends the value of the loop or environment variable with the given
+ * name, which is not null-terminated in the source.
+ */
+static void appendVariable(struct Expansion* out, const char* name, size_t length,
+                           const struct LoopVar* loopVars)
+{
+  char nameBuffer[256];
+  char* heapName = NULL;
+  const char* value;
+
+  for (; loopVars != NULL; loopVars = loopVars->outer) {
+    if (strncmp(loopVars->name, name, length) == 0 && loopVars->name[length] == '\0') {
+      append(out, loopVars->value, strlen(loopVars->value));
+      return;
+    }
+  }
+
+  if (length < sizeof(nameBuffer)) {
+    memcpy(nameBuffer, name, length);
+    nameBuffer[length] = '\0';
+    value = getenv(nameBuffer);
+  } else {
+    heapName = strndup(name, length);
+    value = getenv(heapName);
+    free(heapName);
+  }
+  if (value != NULL) {
+    append(out, value, strlen(value));
+  }
+}
+
+/**
+ *  This function expands the variables in the source line, as described at
+ *  the top of this file, into the given output buffer.
+ *  Returns the expanded, null-terminated line, which stays valid until the
+ *  buffer is used again.
+ */
+char* variableExpand(struct Expansion* out, const char* source, const struct ExpandVars* vars)
+{
+  const char* end = source + strlen(source);
+  const char* dollar;
+  char number[24];
+  size_t length;
+
+  out->length = 0;
+  while ((dollar = memchr(source, '$', end - source)) != NULL) {
+    // Copy everything up to the "$" in one go
+    append(out, source, dollar - source);
+    source = dollar + 1;
+
+    if (*source == '$') {
+      append(out, vars->shellPid, strlen(vars->shellPid));
+      source++;
+    } else if (*source == '?') {
+      append(out, number, sprintf(number, "%d", vars->lastStatus));
+      source++;
+    } else if (*source == '!') {
+      if (vars->lastBgPid != 0) {
+        append(out, number, sprintf(number, "%d", (int)vars->lastBgPid));
+      }
+      source++;
+    } else if (*source == '{' && (length = nameLength(source + 1)) > 0
+               && source[length + 1] == '}') {
+      appendVariable(out, source + 1, length, vars->loopVars);
+      source += length + 2;
+    } else if ((length = nameLength(source)) > 0) {
+      appendVariable(out, source, length, vars->loopVars);
+      source += length;
+    } else {
+      // Not a variable, so the "$" is just a character
+      append(out, "$", 1);
+    }
+  }
+  append(out, source, end - source);
+  out->text[out->length] = '\0';
+  return out->text;
+}
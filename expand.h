@@ -0,0 +1,45 @@
+/*
+ * Filename: expand.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for variable
+ * expansion of command lines.
+ */
+
+#ifndef EXPAND_H
+#define EXPAND_H
+
+#include <stddef.h>
+#include <sys/types.h>
+
+// The variable of a running "for" loop, which hides an environment
+// variable of the same name
+struct LoopVar
+{
+  const char* name;
+  const char* value;
+  const struct LoopVar* outer;  // The variable of the enclosing loop, or NULL
+};
+
+// The values of the shell's special parameters
+struct ExpandVars
+{
+  const char* shellPid;   // $$
+  int lastStatus;         // $?
+  pid_t lastBgPid;        // $!, or 0 if nothing has run in the background
+  const struct LoopVar* loopVars;   // Innermost first, or NULL
+};
+
+// A growable output buffer, reused from one expansion to the next
+struct Expansion
+{
+  char* text;
+  size_t length;
+  size_t capacity;
+};
+
+void expansionInit(struct Expansion* out);
+void expansionFree(struct Expansion* out);
+void expansionAppend(struct Expansion* out, const char* text, size_t length);
+char* variableExpand(struct Expansion* out, const char* source, const struct ExpandVars* vars);
+
+#endif
@@ -0,0 +1,506 @@
+/*
+ * Filename: history.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the command history. The
+ * history file is a ring of fixed-size slots after a small header, mapped
+ * shared into every shell that uses it. Adding a line takes the next
+ * sequence number from the header with an atomic increment and copies the
+ * line into that number's slot, so there is no system call per line and
+ * concurrent shells never write the same slot. A slot's sequence number is
+ * cleared while it is being written and set again once the text is in
+ * place, so a reader that sees the same, expected number before and after
+ * copying the text knows it got a whole line.
+ *
+ * Entries are numbered from 1 across every shell sharing the file; once the
+ * ring wraps, the oldest are overwritten. Lines too long for a slot are
+ * stored cut short and cannot be recalled.
+ *
+ * "!prefix" lookups go through an index from the first word of a line to
+ * the numbers of the entries that start with it, built the first time it
+ * is needed and brought up to date on each lookup. The words are also kept
+ * sorted, so the words a prefix could belong to are found with a binary
+ * search, and the newest entry of each of them is a candidate.
+ */
+
+#include "history.h"
+#include <assert.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HISTORY_MAGIC "SMSHHIST"
+#define HISTORY_VERSION 1
+#define HEADER_SIZE 4096
+#define SLOT_SIZE 512
+#define SLOT_TEXT (SLOT_SIZE - 16)
+#define INITIAL_WORDS 256
+
+struct HistoryHeader
+{
+  char magic[8];
+  uint32_t version;
+  uint32_t slotSize;
+  uint64_t numSlots;
+  uint64_t nextSeq;     // Sequence number of the next line; updated atomically
+};
+
+struct HistorySlot
+{
+  uint64_t seq;         // Entry number (sequence + 1), or 0 while being written
+  uint32_t length;      // Length of the whole line, which may exceed SLOT_TEXT
+  uint32_t unused;
+  char text[SLOT_TEXT];
+};
+
+// A first word and the sequence numbers of the entries that start with it,
+// oldest first
+struct WordEntry
+{
+  char* word;
+  uint64_t* seqs;
+  int count;
+  int capacity;
+};
+
+static struct HistoryHeader* header = NULL;
+static struct HistorySlot* slots = NULL;
+static size_t mappedSize = 0;
+static struct WordEntry** wordSlots = NULL;  // Hash table of words
+static int numWordSlots = 0;                 // Always a power of two
+static struct WordEntry** sortedWords = NULL;  // The same words, by name
+static int numWords = 0;
+static int wordsSorted = 1;       // Whether sortedWords is in order
+static uint64_t indexedSeq = 0;   // Entries before this one are in the index
+
+/**
+ *  This function opens the history file, creating it with room for the given
+ *  number of entries if it does not exist. An existing file keeps the size
+ *  it was created with.
+ *  Returns 0, or -1 if the file could not be opened or is not a history file.
+ */
+int historyOpen(const char* fileName, long numEntries)
+{
+  struct HistoryHeader fresh;
+  struct stat info;
+  int fd = open(fileName, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+
+  if (fd == -1) {
+    return -1;
+  }
+
+  // Only one shell may set up a new file
+  flock(fd, LOCK_EX);
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    return -1;
+  }
+  if (info.st_size == 0) {
+    memset(&fresh, 0, sizeof(fresh));
+    memcpy(fresh.magic, HISTORY_MAGIC, 8);
+    fresh.version = HISTORY_VERSION;
+    fresh.slotSize = SLOT_SIZE;
+    fresh.numSlots = numEntries;
+    info.st_size = HEADER_SIZE + (off_t)numEntries * SLOT_SIZE;
+    // The file is sparse until the ring fills
+    if (ftruncate(fd, info.st_size) == -1
+        || pwrite(fd, &fresh, sizeof(fresh), 0) != sizeof(fresh)) {
+      close(fd);
+      return -1;
+    }
+  }
+  flock(fd, LOCK_UN);
+
+  mappedSize = info.st_size;
+  header = mmap(NULL, mappedSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (header == MAP_FAILED) {
+    header = NULL;
+    return -1;
+  }
+  if (memcmp(header->magic, HISTORY_MAGIC, 8) != 0 || header->version != HISTORY_VERSION
+      || header->slotSize != SLOT_SIZE || header->numSlots == 0
+      || HEADER_SIZE + header->numSlots * SLOT_SIZE > mappedSize) {
+    historyClose();
+    return -1;
+  }
+  slots = (struct HistorySlot*)((char*)header + HEADER_SIZE);
+  return 0;
+}
+
+/**
+ *  This function unmaps the history file and frees the prefix index.
+ */
+void historyClose()
+{
+  for (int i = 0; i < numWords; i++) {
+    free(sortedWords[i]->word);
+    free(sortedWords[i]->seqs);
+    free(sortedWords[i]);
+  }
+  free(wordSlots);
+  free(sortedWords);
+  wordSlots = NULL;
+  sortedWords = NULL;
+  numWordSlots = 0;
+  numWords = 0;
+  indexedSeq = 0;
+  if (header != NULL) {
+    munmap(header, mappedSize);
+    header = NULL;
+  }
+}
+
+/**
+ * Returns the sequence number the next entry will get.
+ */
+static uint64_t nextSeq()
+{
+  return __atomic_load_n(&header->nextSeq, __ATOMIC_ACQUIRE);
+}
+
+/**
+ *  This function appends a line to the history.
+ */
+void historyAdd(const char* line)
+{
+  struct HistorySlot* slot;
+  size_t length = strlen(line);
+  size_t stored = length < SLOT_TEXT - 1 ? length : SLOT_TEXT - 1;
+  uint64_t seq;
+
+  if (header == NULL) {
+    return;
+  }
+  seq = __atomic_fetch_add(&header->nextSeq, 1, __ATOMIC_ACQ_REL);
+  slot = &slots[seq % header->numSlots];
+
+  __atomic_store_n(&slot->seq, 0, __ATOMIC_RELEASE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  memcpy(slot->text, line, stored);
+  slot->text[stored] = '\0';
+  slot->length = length;
+  __atomic_store_n(&slot->seq, seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * Copies the line with the given sequence number into text, which must have
+ * room for SLOT_TEXT bytes.
+ * Returns the length of the whole line, or -1 if the entry has been
+ * overwritten or is still being written.
+ */
+static long readEntry(uint64_t seq, char* text)
+{
+  struct HistorySlot* slot = &slots[seq % header->numSlots];
+  long length;
+
+  if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq + 1) {
+    return -1;
+  }
+  length = slot->length;
+  memcpy(text, slot->text, SLOT_TEXT);
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+  if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != seq + 1) {
+    return -1;
+  }
+  text[SLOT_TEXT - 1] = '\0';
+  return length;
+}
+
+/**
+ * Returns the sequence number of the oldest entry still in the ring.
+ */
+static uint64_t oldestSeq(uint64_t next)
+{
+  return next > header->numSlots ? next - header->numSlots : 0;
+}
+
+/**
+ * FNV-1a hash of a word of the given length.
+ */
+static unsigned int hashWord(const char* word, size_t length)
+{
+  unsigned int hash = 2166136261u;
+
+  for (size_t i = 0; i < length; i++) {
+    hash = (hash ^ (unsigned char)word[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Returns the hash table slot that holds the given word, or the empty slot
+ * where it would be inserted.
+ */
+static int findWordSlot(const char* word, size_t length)
+{
+  int slot = hashWord(word, length) & (numWordSlots - 1);
+
+  while (wordSlots[slot] != NULL && (strncmp(wordSlots[slot]->word, word, length) != 0
+                                     || wordSlots[slot]->word[length] != '\0')) {
+    slot = (slot + 1) & (numWordSlots - 1);
+  }
+  return slot;
+}
+
+/**
+ * Returns the index entry for the given word, adding it if it is new.
+ */
+static struct WordEntry* wordEntry(const char* word, size_t length)
+{
+  struct WordEntry** oldSlots = wordSlots;
+  int oldNumSlots = numWordSlots;
+  struct WordEntry* entry;
+  int slot;
+
+  // Keep the table at most half full
+  if ((numWords + 1) * 2 > numWordSlots) {
+    numWordSlots = numWordSlots == 0 ? INITIAL_WORDS : numWordSlots * 2;
+    wordSlots = calloc(numWordSlots, sizeof(struct WordEntry*));
+    sortedWords = realloc(sortedWords, numWordSlots / 2 * sizeof(struct WordEntry*));
+    assert(wordSlots != 0 && sortedWords != 0);
+    for (int i = 0; i < oldNumSlots; i++) {
+      if (oldSlots[i] != NULL) {
+        wordSlots[findWordSlot(oldSlots[i]->word, strlen(oldSlots[i]->word))] = oldSlots[i];
+      }
+    }
+    free(oldSlots);
+  }
+
+  slot = findWordSlot(word, length);
+  if (wordSlots[slot] == NULL) {
+    entry = calloc(1, sizeof(struct WordEntry));
+    assert(entry != 0);
+    entry->word = strndup(word, length);
+    wordSlots[slot] = entry;
+    sortedWords[numWords++] = entry;
+    wordsSorted = 0;
+  }
+  return wordSlots[slot];
+}
+
+/**
+ * Adds a sequence number to a word's entry. When the entry is full,
+ * numbers that have left the ring are dropped before it is made larger.
+ */
+static void indexAdd(struct WordEntry* entry, uint64_t seq, uint64_t oldest)
+{
+  int kept = 0;
+
+  if (entry->count == entry->capacity) {
+    for (int i = 0; i < entry->count; i++) {
+      if (entry->seqs[i] >= oldest) {
+        entry->seqs[kept++] = entry->seqs[i];
+      }
+    }
+    entry->count = kept;
+  }
+  if (entry->count == entry->capacity) {
+    entry->capacity = entry->capacity == 0 ? 4 : entry->capacity * 2;
+    entry->seqs = realloc(entry->seqs, entry->capacity * sizeof(uint64_t));
+    assert(entry->seqs != 0);
+  }
+  entry->seqs[entry->count++] = seq;
+}
+
+/**
+ * Brings the prefix index up to date with every entry added so far, by this
+ * shell or any other.
+ */
+static void indexUpdate()
+{
+  char text[SLOT_TEXT];
+  uint64_t next = nextSeq();
+  uint64_t oldest = oldestSeq(next);
+
+  if (indexedSeq < oldest) {
+    indexedSeq = oldest;
+  }
+  for (; indexedSeq < next; indexedSeq++) {
+    if (readEntry(indexedSeq, text) >= 0) {
+      indexAdd(wordEntry(text, strcspn(text, " ")), indexedSeq, oldest);
+    }
+  }
+}
+
+static int compareWords(const void* a, const void* b)
+{
+  return strcmp((*(struct WordEntry* const*)a)->word, (*(struct WordEntry* const*)b)->word);
+}
+
+/**
+ * Finds the newest entry of a word's entry list that starts with the given
+ * prefix and copies it into text.
+ * Returns its sequence number plus one, or 0 if there is none.
+ */
+static uint64_t newestMatch(struct WordEntry* entry, const char* prefix, char* text,
+                            uint64_t oldest, long* length)
+{
+  for (int i = entry->count - 1; i >= 0 && entry->seqs[i] >= oldest; i--) {
+    *length = readEntry(entry->seqs[i], text);
+    if (*length >= 0 && strncmp(text, prefix, strlen(prefix)) == 0) {
+      return entry->seqs[i] + 1;
+    }
+  }
+  return 0;
+}
+
+/**
+ * Finds the most recent entry that starts with the given prefix and copies
+ * it into text. If the prefix contains the whole first word, only the
+ * entries with that word are searched; otherwise the newest entry of each
+ * word that starts with the prefix is compared.
+ * Returns the length of the whole line, or -1 if there is no such entry.
+ */
+static long findPrefix(const char* prefix, char* text)
+{
+  char candidate[SLOT_TEXT];
+  size_t prefixLength = strlen(prefix);
+  size_t wordLength = strcspn(prefix, " ");
+  uint64_t oldest = oldestSeq(nextSeq());
+  uint64_t best = 0;
+  uint64_t found;
+  long length = -1;
+  long candidateLength;
+  int low = 0;
+  int high;
+  int middle;
+
+  indexUpdate();
+  if (numWords == 0) {
+    return -1;
+  }
+
+  if (wordLength < prefixLength) {
+    middle = findWordSlot(prefix, wordLength);
+    if (wordSlots[middle] == NULL
+        || newestMatch(wordSlots[middle], prefix, text, oldest, &length) == 0) {
+      return -1;
+    }
+    return length;
+  }
+
+  if (!wordsSorted) {
+    qsort(sortedWords, numWords, sizeof(struct WordEntry*), compareWords);
+    wordsSorted = 1;
+  }
+  // The first word not before the prefix; the words that start with it follow
+  high = numWords;
+  while (low < high) {
+    middle = (low + high) / 2;
+    if (strcmp(sortedWords[middle]->word, prefix) < 0) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+  for (; low < numWords && strncmp(sortedWords[low]->word, prefix, prefixLength) == 0; low++) {
+    found = newestMatch(sortedWords[low], prefix, candidate, oldest, &candidateLength);
+    if (found > best) {
+      best = found;
+      length = candidateLength;
+      memcpy(text, candidate, SLOT_TEXT);
+    }
+  }
+  return length;
+}
+
+/**
+ *  This function expands a history reference at the start of a line:
+ *  "!!" is the last entry, "!n" entry n, "!-n" the nth entry back, and
+ *  "!prefix" the last entry that starts with prefix. The rest of the line
+ *  after the reference is appended to the entry.
+ *  Returns the expanded line, which the caller must free, or NULL after
+ *  printing why the reference could not be expanded.
+ */
+char* historyExpand(const char* line)
+{
+  char text[SLOT_TEXT];
+  char prefix[SLOT_TEXT];
+  const char* rest = line + strcspn(line, " ");
+  size_t refLength = rest - line;
+  uint64_t next;
+  long number;
+  long length = -1;
+  char* expanded;
+  char* end;
+
+  if (header == NULL) {
+    printf("%.*s: no history\n", (int)refLength, line);
+    fflush(stdout);
+    return NULL;
+  }
+
+  next = nextSeq();
+  number = strtol(line + 1, &end, 10);
+  if (strncmp(line, "!!", refLength) == 0 && refLength == 2) {
+    if (next > 0) {
+      length = readEntry(next - 1, text);
+    }
+  } else if (end == rest && end != line + 1) {
+    if (number < 0) {
+      number += next + 1;
+    }
+    if (number >= 1 && (uint64_t)number <= next) {
+      length = readEntry(number - 1, text);
+    }
+  } else if (refLength > 1 && refLength < SLOT_TEXT) {
+    memcpy(prefix, line + 1, refLength - 1);
+    prefix[refLength - 1] = '\0';
+    length = findPrefix(prefix, text);
+  }
+
+  if (length < 0) {
+    printf("%.*s: event not found\n", (int)refLength, line);
+    fflush(stdout);
+    return NULL;
+  }
+  if (length > SLOT_TEXT - 1) {
+    printf("%.*s: entry too long to recall\n", (int)refLength, line);
+    fflush(stdout);
+    return NULL;
+  }
+
+  expanded = malloc(length + strlen(rest) + 1);
+  memcpy(expanded, text, length);
+  strcpy(expanded + length, rest);
+  return expanded;
+}
+
+/**
+ *  This function implements the "history [n]" built-in, listing the last n
+ *  entries (by default, every entry in the ring) with their numbers.
+ *  Returns 0, or 1 if there is no history.
+ */
+int historyPrint(long count)
+{
+  char text[SLOT_TEXT];
+  uint64_t next;
+  uint64_t first;
+  long length;
+
+  if (header == NULL) {
+    printf("history: no history file\n");
+    fflush(stdout);
+    return 1;
+  }
+  next = nextSeq();
+  first = oldestSeq(next);
+  if (count > 0 && (uint64_t)count < next - first) {
+    first = next - count;
+  }
+  for (uint64_t seq = first; seq < next; seq++) {
+    length = readEntry(seq, text);
+    if (length >= 0) {
+      printf("%5lu  %s%s\n", (unsigned long)(seq + 1), text,
+             length > SLOT_TEXT - 1 ? "..." : "");
+    }
+  }
+  fflush(stdout);
+  return 0;
+}
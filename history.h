@@ -0,0 +1,18 @@
+/*
+ * Filename: history.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the command
+ * history. Like the path cache, there is one history for the whole process,
+ * backed by a file that several shells may share.
+ */
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+int historyOpen(const char* fileName, long numEntries);
+void historyClose();
+void historyAdd(const char* line);
+char* historyExpand(const char* line);
+int historyPrint(long count);
+
+#endif
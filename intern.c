@@ -0,0 +1,145 @@
+/*
+ * Filename: intern.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the table of interned
+ * strings. Each distinct string is stored once, in an allocation that also
+ * holds its hash and a reference count, and the table is a linear-probing
+ * hash map of pointers to them, like the path cache. A string is freed
+ * when its last reference is released.
+ */
+
+#include "intern.h"
+#include <assert.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define INITIAL_SLOTS 64
+
+struct Interned
+{
+  unsigned int hash;
+  int refs;
+  char text[];
+};
+
+static struct Interned** slots = NULL;
+static int numSlots = 0;      // Always a power of two
+static int numEntries = 0;
+
+/**
+ * FNV-1a hash of the first length bytes of text.
+ */
+static unsigned int hashText(const char* text, int length)
+{
+  unsigned int hash = 2166136261u;
+
+  for (int i = 0; i < length; i++) {
+    hash = (hash ^ (unsigned char)text[i]) * 16777619u;
+  }
+  return hash;
+}
+
+/**
+ * Returns the slot that holds the given text, or the empty slot where it
+ * would be inserted.
+ */
+static int findSlot(const char* text, int length, unsigned int hash)
+{
+  int slot = hash & (numSlots - 1);
+
+  while (slots[slot] != NULL
+         && (slots[slot]->hash != hash || strncmp(slots[slot]->text, text, length) != 0
+             || slots[slot]->text[length] != '\0')) {
+    slot = (slot + 1) & (numSlots - 1);
+  }
+  return slot;
+}
+
+/**
+ * Doubles the number of slots, or allocates the first ones.
+ */
+static void grow()
+{
+  struct Interned** oldSlots = slots;
+  int oldNumSlots = numSlots;
+  int slot;
+
+  numSlots = numSlots == 0 ? INITIAL_SLOTS : numSlots * 2;
+  slots = calloc(numSlots, sizeof(struct Interned*));
+  assert(slots != 0);
+
+  for (int i = 0; i < oldNumSlots; i++) {
+    if (oldSlots[i] != NULL) {
+      slot = oldSlots[i]->hash & (numSlots - 1);
+      while (slots[slot] != NULL) {
+        slot = (slot + 1) & (numSlots - 1);
+      }
+      slots[slot] = oldSlots[i];
+    }
+  }
+  free(oldSlots);
+}
+
+/**
+ * Returns the shared copy of the first length bytes of text, adding a
+ * reference to it. Each call must be matched by a call to internRelease().
+ */
+const char* internString(const char* text, int length)
+{
+  unsigned int hash = hashText(text, length);
+  struct Interned* entry;
+  int slot;
+
+  // Keep the table at most half full
+  if ((numEntries + 1) * 2 > numSlots) {
+    grow();
+  }
+  slot = findSlot(text, length, hash);
+  if (slots[slot] == NULL) {
+    entry = malloc(sizeof(struct Interned) + length + 1);
+    assert(entry != 0);
+    entry->hash = hash;
+    entry->refs = 0;
+    memcpy(entry->text, text, length);
+    entry->text[length] = '\0';
+    slots[slot] = entry;
+    numEntries++;
+  }
+  slots[slot]->refs++;
+  return slots[slot]->text;
+}
+
+/**
+ * Drops a reference to a string returned by internString(), freeing it if
+ * it was the last one. Later entries of the same cluster are shifted back
+ * so that no lookup runs into the hole.
+ */
+void internRelease(const char* text)
+{
+  struct Interned* entry = (struct Interned*)(text - offsetof(struct Interned, text));
+  int mask = numSlots - 1;
+  int slot, next, home;
+
+  if (--entry->refs > 0) {
+    return;
+  }
+
+  slot = entry->hash & mask;
+  while (slots[slot] != entry) {
+    slot = (slot + 1) & mask;
+  }
+  free(entry);
+  slots[slot] = NULL;
+  numEntries--;
+
+  for (next = (slot + 1) & mask; slots[next] != NULL; next = (next + 1) & mask) {
+    home = slots[next]->hash & mask;
+    // Move the entry back if its home is not between the hole and itself
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      slots[slot] = slots[next];
+      slots[next] = NULL;
+      slot = next;
+    }
+  }
+}
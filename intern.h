@@ -0,0 +1,15 @@
+/*
+ * Filename: intern.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the table of
+ * interned strings, which lets many records that hold the same text share
+ * one reference-counted copy of it.
+ */
+
+#ifndef INTERN_H
+#define INTERN_H
+
+const char* internString(const char* text, int length);
+void internRelease(const char* text);
+
+#endif
@@ -0,0 +1,392 @@
+/*
+ * Filename: jobTable.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the table of background
+ * jobs. Job records live in a dense array. A linear-probing hash map from
+ * pid to array index and a direct array from job ID to array index make
+ * both kinds of lookup O(1). Removal moves the last record into the hole,
+ * so the dense array never has gaps.
+ *
+ * A record is a few words: the pipeline it was made from is not kept, its
+ * resource usage is kept as three fixed-width counters, and its command
+ * text is interned, so a thousand copies of the same line
+ * running in the background share one string.
+ */
+
+#include "jobTable.h"
+#include "intern.h"
+#include "metrics.h"
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#define INITIAL_CAPACITY 16
+
+struct JobTable
+{
+  struct Job* jobs;     // Dense array of job records
+  int size;
+  int capacity;
+
+  int* slots;           // Hash map of pid -> index + 1 (0 means empty)
+  int numSlots;         // Always a power of two, at least twice capacity
+
+  int* idIndex;         // Job ID -> index + 1 (0 means unused)
+  int maxId;            // Highest job ID ever handed out
+  int idCapacity;
+  int* freeIds;         // Stack of released job IDs, reused first
+  int numFreeIds;
+};
+
+/**
+ * Hashes a pid to its home slot. Pids are handed out sequentially, so a
+ * multiplicative hash spreads consecutive pids across the table.
+ */
+static int homeSlot(struct JobTable* table, pid_t pid)
+{
+  return (int)(((unsigned int)pid * 2654435761u) & (table->numSlots - 1));
+}
+
+/**
+ * Returns the slot that holds the given pid, or the empty slot where it
+ * would be inserted.
+ */
+static int findSlot(struct JobTable* table, pid_t pid)
+{
+  int slot = homeSlot(table, pid);
+
+  while (table->slots[slot] != 0 && table->jobs[table->slots[slot] - 1].pid != pid) {
+    slot = (slot + 1) & (table->numSlots - 1);
+  }
+  return slot;
+}
+
+/**
+ * Rebuilds the hash map with the given number of slots.
+ */
+static void rehash(struct JobTable* table, int numSlots)
+{
+  free(table->slots);
+  table->numSlots = numSlots;
+  table->slots = calloc(numSlots, sizeof(int));
+  assert(table->slots != 0);
+
+  for (int i = 0; i < table->size; i++) {
+    table->slots[findSlot(table, table->jobs[i].pid)] = i + 1;
+  }
+}
+
+/**
+ * Empties the given slot. With linear probing, later entries of the same
+ * cluster are shifted back so that no lookup runs into the hole.
+ */
+static void clearSlot(struct JobTable* table, int slot)
+{
+  int mask = table->numSlots - 1;
+  int next = (slot + 1) & mask;
+  int home;
+
+  table->slots[slot] = 0;
+  while (table->slots[next] != 0) {
+    home = homeSlot(table, table->jobs[table->slots[next] - 1].pid);
+    // Move the entry back if its home is not between the hole and itself
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      table->slots[slot] = table->slots[next];
+      table->slots[next] = 0;
+      slot = next;
+    }
+    next = (next + 1) & mask;
+  }
+}
+
+/**
+ * Hands out a job ID, preferring one that has been released.
+ */
+static int allocateId(struct JobTable* table)
+{
+  if (table->numFreeIds > 0) {
+    table->numFreeIds--;
+    return table->freeIds[table->numFreeIds];
+  }
+
+  table->maxId++;
+  if (table->maxId >= table->idCapacity) {
+    table->idCapacity *= 2;
+    table->idIndex = realloc(table->idIndex, table->idCapacity * sizeof(int));
+    table->freeIds = realloc(table->freeIds, table->idCapacity * sizeof(int));
+    assert(table->idIndex != 0 && table->freeIds != 0);
+  }
+  return table->maxId;
+}
+
+/**
+ * Allocates and initializes an empty job table.
+ */
+struct JobTable* jobTableCreate()
+{
+  struct JobTable* table = malloc(sizeof(struct JobTable));
+  assert(table != 0);
+
+  table->size = 0;
+  table->capacity = INITIAL_CAPACITY;
+  table->jobs = malloc(table->capacity * sizeof(struct Job));
+
+  table->numSlots = INITIAL_CAPACITY * 2;
+  table->slots = calloc(table->numSlots, sizeof(int));
+
+  table->maxId = 0;
+  table->idCapacity = INITIAL_CAPACITY;
+  table->idIndex = calloc(table->idCapacity, sizeof(int));
+  table->freeIds = malloc(table->idCapacity * sizeof(int));
+  table->numFreeIds = 0;
+
+  assert(table->jobs != 0 && table->slots != 0);
+  assert(table->idIndex != 0 && table->freeIds != 0);
+  return table;
+}
+
+/**
+ * Releases the command text of every job still in the table, then frees
+ * the table.
+ */
+void jobTableDestroy(struct JobTable* table)
+{
+  for (int i = 0; i < table->size; i++) {
+    internRelease(table->jobs[i].command);
+  }
+  free(table->jobs);
+  free(table->slots);
+  free(table->idIndex);
+  free(table->freeIds);
+  free(table);
+}
+
+int jobTableSize(struct JobTable* table)
+{
+  return table->size;
+}
+
+/**
+ * Returns the highest job ID handed out so far. Every live job has an ID
+ * between 1 and this value, so it bounds an in-order walk of the jobs.
+ */
+int jobTableMaxId(struct JobTable* table)
+{
+  return table->maxId;
+}
+
+/**
+ * Returns the text of a pipeline as "jobs" shows it: its launch limits as
+ * "@" modifiers, then the words of each stage, with "|" between stages.
+ * The text is built in a buffer that is reused by the next call.
+ */
+static const char* commandText(const struct Pipeline* pipeline, int* length)
+{
+  static char* text = NULL;
+  static size_t capacity = 0;
+  char limits[LIMITS_TEXT_SIZE];
+  size_t needed;
+  char* out;
+  char* setting;
+  struct Command* stage;
+
+  // Every limit setting gains an "@", and every word a separator
+  limitsFormat(&pipeline->limits, limits, sizeof(limits));
+  needed = 2 * strlen(limits) + 2;
+  for (int i = 0; i < pipeline->numStages; i++) {
+    stage = pipeline->stages[i];
+    needed += 2;
+    for (int j = 0; j < stage->numArgs; j++) {
+      needed += strlen(stage->args[j]) + 1;
+    }
+  }
+  if (needed > capacity) {
+    capacity = needed;
+    text = realloc(text, capacity);
+    assert(text != 0);
+  }
+
+  out = text;
+  for (setting = strtok(limits, " "); setting != NULL; setting = strtok(NULL, " ")) {
+    out += sprintf(out, "@%s ", setting);
+  }
+  for (int i = 0; i < pipeline->numStages; i++) {
+    stage = pipeline->stages[i];
+    if (i > 0) {
+      out += sprintf(out, "| ");
+    }
+    for (int j = 0; j < stage->numArgs; j++) {
+      out += sprintf(out, "%s ", stage->args[j]);
+    }
+  }
+  // Drop the last separator
+  if (out > text) {
+    out--;
+  }
+  *out = '\0';
+  *length = out - text;
+  return text;
+}
+
+/**
+ * Adds a job for a pipeline that has just been launched, and returns its
+ * record. The record does not refer to the pipeline, which stays the
+ * caller's to destroy.
+ */
+struct Job* jobTableAdd(struct JobTable* table, const struct Pipeline* pipeline)
+{
+  struct Job* job;
+  const char* text;
+  int length;
+
+  if (table->size == table->capacity) {
+    table->capacity *= 2;
+    table->jobs = realloc(table->jobs, table->capacity * sizeof(struct Job));
+    assert(table->jobs != 0);
+    rehash(table, table->capacity * 2);
+  }
+
+  job = &table->jobs[table->size];
+  job->id = allocateId(table);
+  job->pid = pipeline->myPid;
+  job->pgid = pipeline->pgid;
+  job->status = 0;
+  job->startTime = pipeline->startTime;
+  job->endTime.tv_sec = 0;
+  job->endTime.tv_nsec = 0;
+  job->userMillis = 0;
+  job->sysMillis = 0;
+  job->maxRssKB = 0;
+  text = commandText(pipeline, &length);
+  job->command = internString(text, length);
+  table->size++;
+
+  table->slots[findSlot(table, job->pid)] = table->size;
+  table->idIndex[job->id] = table->size;
+  return job;
+}
+
+/**
+ * Returns the job with the given pid, or NULL if there isn't one.
+ */
+struct Job* jobTableFindPid(struct JobTable* table, pid_t pid)
+{
+  int slot = findSlot(table, pid);
+
+  if (table->slots[slot] == 0) {
+    return NULL;
+  }
+  return &table->jobs[table->slots[slot] - 1];
+}
+
+/**
+ * Returns the job with the given job ID, or NULL if there isn't one.
+ */
+struct Job* jobTableFindId(struct JobTable* table, int id)
+{
+  if (id < 1 || id > table->maxId || table->idIndex[id] == 0) {
+    return NULL;
+  }
+  return &table->jobs[table->idIndex[id] - 1];
+}
+
+/**
+ * Removes the given job from the table, releases its command text and its
+ * job ID. The last record in the array is moved into its place.
+ */
+void jobTableRemove(struct JobTable* table, struct Job* job)
+{
+  int index = job - table->jobs;
+  struct Job* last = &table->jobs[table->size - 1];
+
+  clearSlot(table, findSlot(table, job->pid));
+  table->idIndex[job->id] = 0;
+  table->freeIds[table->numFreeIds] = job->id;
+  table->numFreeIds++;
+  internRelease(job->command);
+
+  if (job != last) {
+    *job = *last;
+    table->slots[findSlot(table, job->pid)] = index + 1;
+    table->idIndex[job->id] = index + 1;
+  }
+  table->size--;
+}
+
+/**
+ * Records that a job has finished with the given wait status, and when, and
+ * keeps a summary of the resource usage wait4() reported for it.
+ */
+void jobFinished(struct Job* job, int status, const struct rusage* usage)
+{
+  job->status = status;
+  clock_gettime(CLOCK_MONOTONIC, &job->endTime);
+  job->userMillis = usage->ru_utime.tv_sec * 1000 + usage->ru_utime.tv_usec / 1000;
+  job->sysMillis = usage->ru_stime.tv_sec * 1000 + usage->ru_stime.tv_usec / 1000;
+  job->maxRssKB = usage->ru_maxrss;
+  metricsCountReap();
+}
+
+/**
+ * Returns the number of seconds the job has been running, or ran for if it
+ * has finished.
+ */
+double jobElapsed(const struct Job* job)
+{
+  struct timespec end = job->endTime;
+
+  if (end.tv_sec == 0 && end.tv_nsec == 0) {
+    clock_gettime(CLOCK_MONOTONIC, &end);
+  }
+  return (end.tv_sec - job->startTime.tv_sec)
+         + (end.tv_nsec - job->startTime.tv_nsec) / 1e9;
+}
+
+/**
+ * Fills in the resource usage of a job that is still running from
+ * /proc/pid/stat and /proc/pid/status, since wait4() only reports it once
+ * the job has been reaped.
+ * Returns 0, or -1 if the process could not be read.
+ */
+int jobSampleUsage(struct Job* job)
+{
+  char fileName[64];
+  char line[512];
+  unsigned long userTicks, sysTicks;
+  long ticksPerSecond = sysconf(_SC_CLK_TCK);
+  char* fields;
+  FILE* file;
+  int result = -1;
+
+  sprintf(fileName, "/proc/%d/stat", job->pid);
+  file = fopen(fileName, "r");
+  if (file == NULL) {
+    return -1;
+  }
+  // The command name may contain spaces, so the fields are counted from
+  // the ")" that ends it; utime and stime are fields 14 and 15
+  if (fgets(line, sizeof(line), file) != NULL
+      && (fields = strrchr(line, ')')) != NULL
+      && sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                &userTicks, &sysTicks) == 2) {
+    job->userMillis = userTicks * 1000 / ticksPerSecond;
+    job->sysMillis = sysTicks * 1000 / ticksPerSecond;
+    result = 0;
+  }
+  fclose(file);
+
+  sprintf(fileName, "/proc/%d/status", job->pid);
+  file = fopen(fileName, "r");
+  if (file == NULL) {
+    return result;
+  }
+  while (fgets(line, sizeof(line), file) != NULL) {
+    if (sscanf(line, "VmHWM: %u kB", &job->maxRssKB) == 1) {
+      break;
+    }
+  }
+  fclose(file);
+  return result;
+}
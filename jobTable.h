@@ -0,0 +1,53 @@
+/*
+ * Filename: jobTable.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the table of
+ * background jobs. Jobs are kept in a dense array and indexed by pid with an
+ * open-addressing hash map, and by a small job ID that stays the same for
+ * the life of the job, so looking a job up by either is O(1).
+ */
+
+#ifndef JOB_TABLE_H
+#define JOB_TABLE_H
+
+#include "command.h"
+#include <stdint.h>
+
+// A background job. The record is made from the pipeline when the job is
+// added and keeps only what is needed to report and signal the job, so the
+// pipeline can be destroyed as soon as it has been launched. Its resource
+// usage is that of its last stage, as reported by wait4() when it is reaped.
+struct Job
+{
+  int id;       // Small job ID, as used by %id
+  pid_t pid;    // The pipeline's last stage
+  pid_t pgid;   // Process group of the pipeline, or 0 if it has none
+  int status;   // Wait status, once the job has finished
+  struct timespec startTime;  // When the pipeline was launched
+  struct timespec endTime;    // When it was reaped, or zero
+  uint32_t userMillis;        // User CPU time, once it has been reaped
+  uint32_t sysMillis;         // System CPU time
+  uint32_t maxRssKB;          // Largest resident set size
+  const char* command;        // Interned text of the line, "@" modifiers included
+};
+
+struct JobTable;
+
+struct JobTable* jobTableCreate();
+void jobTableDestroy(struct JobTable* table);
+int jobTableSize(struct JobTable* table);
+int jobTableMaxId(struct JobTable* table);
+
+/* Pointers returned by these functions are only valid until the next call
+ * to jobTableAdd() or jobTableRemove(), which may move records around.
+ */
+struct Job* jobTableAdd(struct JobTable* table, const struct Pipeline* pipeline);
+struct Job* jobTableFindPid(struct JobTable* table, pid_t pid);
+struct Job* jobTableFindId(struct JobTable* table, int id);
+void jobTableRemove(struct JobTable* table, struct Job* job);
+
+void jobFinished(struct Job* job, int status, const struct rusage* usage);
+double jobElapsed(const struct Job* job);
+int jobSampleUsage(struct Job* job);
+
+#endif
@@ -0,0 +1,261 @@
+/*
+ * Filename: launchLimits.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for launch limits. They are
+ * written as settings of the form
+ *
+ *   cpu=0-3,6   the CPUs the command may run on
+ *   nice=10     its nice value
+ *   mem=2G      its address space limit, with an optional K, M, G or T
+ *
+ * either as "@" modifiers at the start of a command line or as arguments to
+ * the "limit" built-in, and are applied in the child between fork() and
+ * exec().
+ */
+
+#define _GNU_SOURCE   // sched_setaffinity()
+#include "launchLimits.h"
+#include <ctype.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#define BITS_PER_WORD (8 * sizeof(unsigned long))
+
+/**
+ * Resets the limits so that nothing is changed at launch.
+ */
+void limitsClear(struct LaunchLimits* limits)
+{
+  memset(limits, 0, sizeof(struct LaunchLimits));
+}
+
+/**
+ * Returns 1 if no limit is set, and 0 otherwise.
+ */
+int limitsEmpty(const struct LaunchLimits* limits)
+{
+  return !limits->hasCpus && !limits->hasNice && limits->mem == 0;
+}
+
+/**
+ * Parses a CPU list such as "0-3,6" into the mask.
+ * Returns 0, or -1 if the list is malformed or names a CPU out of range.
+ */
+static int parseCpus(const char* text, unsigned long* mask)
+{
+  long first, last;
+  char* end;
+
+  memset(mask, 0, LIMITS_MASK_WORDS * sizeof(unsigned long));
+  while (1) {
+    if (!isdigit((unsigned char)*text)) {
+      return -1;
+    }
+    first = strtol(text, &end, 10);
+    last = first;
+    if (*end == '-') {
+      text = end + 1;
+      if (!isdigit((unsigned char)*text)) {
+        return -1;
+      }
+      last = strtol(text, &end, 10);
+    }
+    if (last < first || last >= LIMITS_MAX_CPUS) {
+      return -1;
+    }
+    for (long cpu = first; cpu <= last; cpu++) {
+      mask[cpu / BITS_PER_WORD] |= 1UL << (cpu % BITS_PER_WORD);
+    }
+    if (*end == '\0') {
+      return 0;
+    }
+    if (*end != ',') {
+      return -1;
+    }
+    text = end + 1;
+  }
+}
+
+/**
+ * Parses a size such as "512M" into bytes.
+ * Returns the size, or 0 if it is malformed.
+ */
+static rlim_t parseSize(const char* text)
+{
+  unsigned long long size;
+  char* end;
+
+  if (!isdigit((unsigned char)*text)) {
+    return 0;
+  }
+  size = strtoull(text, &end, 10);
+  switch (toupper((unsigned char)*end)) {
+    case 'T':
+      size <<= 10;
+      // Fall through
+    case 'G':
+      size <<= 10;
+      // Fall through
+    case 'M':
+      size <<= 10;
+      // Fall through
+    case 'K':
+      size <<= 10;
+      end++;
+      break;
+  }
+  return *end == '\0' ? size : 0;
+}
+
+/**
+ *  This function applies one "name=value" setting to the limits. An empty
+ *  value clears that limit.
+ *  Returns 0, or -1 after printing why the setting is invalid.
+ */
+int limitsSet(struct LaunchLimits* limits, const char* setting)
+{
+  const char* value = strchr(setting, '=');
+  size_t nameLength = value != NULL ? (size_t)(value - setting) : strlen(setting);
+  char* end;
+
+  if (value == NULL) {
+    printf("%s: expected name=value\n", setting);
+    fflush(stdout);
+    return -1;
+  }
+  value++;
+
+  if (nameLength == 3 && strncmp(setting, "cpu", 3) == 0) {
+    limits->hasCpus = *value != '\0';
+    if (limits->hasCpus && parseCpus(value, limits->cpuMask) == -1) {
+      limits->hasCpus = 0;
+      printf("%s: invalid CPU list\n", setting);
+      fflush(stdout);
+      return -1;
+    }
+  } else if (nameLength == 4 && strncmp(setting, "nice", 4) == 0) {
+    limits->hasNice = *value != '\0';
+    if (limits->hasNice) {
+      limits->nice = strtol(value, &end, 10);
+      if (*end != '\0' || limits->nice < -20 || limits->nice > 19) {
+        limits->hasNice = 0;
+        printf("%s: nice must be from -20 to 19\n", setting);
+        fflush(stdout);
+        return -1;
+      }
+    }
+  } else if (nameLength == 3 && strncmp(setting, "mem", 3) == 0) {
+    limits->mem = 0;
+    if (*value != '\0' && (limits->mem = parseSize(value)) == 0) {
+      printf("%s: invalid size\n", setting);
+      fflush(stdout);
+      return -1;
+    }
+  } else {
+    printf("%s: unknown limit (cpu, nice or mem)\n", setting);
+    fflush(stdout);
+    return -1;
+  }
+  return 0;
+}
+
+/**
+ * Fills in every limit that is not set from the defaults.
+ */
+void limitsMerge(struct LaunchLimits* limits, const struct LaunchLimits* defaults)
+{
+  if (!limits->hasCpus && defaults->hasCpus) {
+    limits->hasCpus = 1;
+    memcpy(limits->cpuMask, defaults->cpuMask, sizeof(limits->cpuMask));
+  }
+  if (!limits->hasNice && defaults->hasNice) {
+    limits->hasNice = 1;
+    limits->nice = defaults->nice;
+  }
+  if (limits->mem == 0) {
+    limits->mem = defaults->mem;
+  }
+}
+
+/**
+ * Writes the limits that are set in the same "name=value" form they are
+ * given in, separated by spaces. CPU lists are written as ranges.
+ */
+void limitsFormat(const struct LaunchLimits* limits, char* text, size_t size)
+{
+  size_t used = 0;
+  int first = -1;
+  int isSet;
+  const char* units = "KMGT";
+  unsigned long long mem = limits->mem;
+  int unit = -1;
+
+  text[0] = '\0';
+  if (limits->hasCpus) {
+    used += snprintf(text + used, size - used, "cpu=");
+    for (int cpu = 0; cpu <= LIMITS_MAX_CPUS && used < size; cpu++) {
+      isSet = cpu < LIMITS_MAX_CPUS
+              && (limits->cpuMask[cpu / BITS_PER_WORD] & (1UL << (cpu % BITS_PER_WORD)));
+      if (isSet && first == -1) {
+        first = cpu;
+      } else if (!isSet && first != -1) {
+        used += snprintf(text + used, size - used, "%s%d", text[used - 1] == '=' ? "" : ",", first);
+        if (cpu - 1 > first && used < size) {
+          used += snprintf(text + used, size - used, "-%d", cpu - 1);
+        }
+        first = -1;
+      }
+    }
+  }
+  if (limits->hasNice && used < size) {
+    used += snprintf(text + used, size - used, "%snice=%d", used > 0 ? " " : "", limits->nice);
+  }
+  if (limits->mem != 0 && used < size) {
+    while (unit < 3 && mem % 1024 == 0) {
+      mem /= 1024;
+      unit++;
+    }
+    used += snprintf(text + used, size - used, "%smem=%llu%.*s", used > 0 ? " " : "",
+                     mem, unit >= 0 ? 1 : 0, unit >= 0 ? units + unit : "");
+  }
+}
+
+/**
+ *  This function applies the limits to the calling process. It is meant to
+ *  be called in a child just before exec().
+ *  Returns 0, or -1 after printing which limit could not be applied.
+ */
+int limitsApply(const struct LaunchLimits* limits)
+{
+  cpu_set_t cpus;
+  struct rlimit memLimit;
+
+  if (limits->hasCpus) {
+    CPU_ZERO(&cpus);
+    for (int cpu = 0; cpu < LIMITS_MAX_CPUS && cpu < CPU_SETSIZE; cpu++) {
+      if (limits->cpuMask[cpu / BITS_PER_WORD] & (1UL << (cpu % BITS_PER_WORD))) {
+        CPU_SET(cpu, &cpus);
+      }
+    }
+    if (sched_setaffinity(0, sizeof(cpus), &cpus) == -1) {
+      perror("cpu");
+      return -1;
+    }
+  }
+  if (limits->hasNice && setpriority(PRIO_PROCESS, 0, limits->nice) == -1) {
+    perror("nice");
+    return -1;
+  }
+  if (limits->mem != 0) {
+    memLimit.rlim_cur = limits->mem;
+    memLimit.rlim_max = limits->mem;
+    if (setrlimit(RLIMIT_AS, &memLimit) == -1) {
+      perror("mem");
+      return -1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,34 @@
+/*
+ * Filename: launchLimits.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for launch limits:
+ * the CPU affinity, nice value and memory limit a command is started with.
+ */
+
+#ifndef LAUNCH_LIMITS_H
+#define LAUNCH_LIMITS_H
+
+#include <stddef.h>
+#include <sys/resource.h>
+
+#define LIMITS_MAX_CPUS 1024
+#define LIMITS_MASK_WORDS (LIMITS_MAX_CPUS / (8 * sizeof(unsigned long)))
+#define LIMITS_TEXT_SIZE 256  // Enough for limitsFormat() in all but odd cases
+
+struct LaunchLimits
+{
+  int hasCpus;
+  unsigned long cpuMask[LIMITS_MASK_WORDS]; // CPUs it may run on, if hasCpus
+  int hasNice;
+  int nice;         // Nice value, if hasNice
+  rlim_t mem;       // RLIMIT_AS in bytes, or 0 for no limit
+};
+
+void limitsClear(struct LaunchLimits* limits);
+int limitsEmpty(const struct LaunchLimits* limits);
+int limitsSet(struct LaunchLimits* limits, const char* setting);
+void limitsMerge(struct LaunchLimits* limits, const struct LaunchLimits* defaults);
+void limitsFormat(const struct LaunchLimits* limits, char* text, size_t size);
+int limitsApply(const struct LaunchLimits* limits);
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ * Filename: lineReader.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the line reader. Input
+ * is read with read() straight into a buffer, and lines are handed out in
+ * place, with the newline replaced by a null terminator, so a line is never
+ * copied on its way to the parser. A terminal hands over one line per
+ * read(), so only a small read is asked of it; anything else is read in
+ * large blocks. The buffer doubles whenever a line doesn't fit, so lines
+ * have no length limit.
+ */
+
+#include "lineReader.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+
+#define TTY_READ_SIZE 4096
+#define BLOCK_READ_SIZE (1 << 16)
+
+struct LineReader
+{
+  int fd;
+  char* buffer;
+  size_t capacity;
+  size_t start;       // First byte not yet handed out
+  size_t end;         // One past the last byte read
+  size_t readSize;    // How much to ask read() for at a time
+  int eof;
+  int isTerminal;
+};
+
+/**
+ * Creates a reader for the given file descriptor.
+ */
+struct LineReader* lineReaderCreate(int fd)
+{
+  struct LineReader* reader = malloc(sizeof(struct LineReader));
+  assert(reader != 0);
+
+  reader->fd = fd;
+  reader->isTerminal = isatty(fd);
+  reader->readSize = reader->isTerminal ? TTY_READ_SIZE : BLOCK_READ_SIZE;
+  // One extra byte so a last line without a newline can still be terminated
+  reader->capacity = reader->readSize + 1;
+  reader->buffer = malloc(reader->capacity);
+  assert(reader->buffer != 0);
+  reader->start = 0;
+  reader->end = 0;
+  reader->eof = 0;
+  return reader;
+}
+
+/**
+ * Frees the reader. The file descriptor is left open.
+ */
+void lineReaderDestroy(struct LineReader* reader)
+{
+  free(reader->buffer);
+  free(reader);
+}
+
+/**
+ * Returns 1 if a whole line is already buffered, so the next call to
+ * lineReaderNext() will not read, and 0 otherwise.
+ */
+int lineReaderHasLine(struct LineReader* reader)
+{
+  return memchr(reader->buffer + reader->start, '\n', reader->end - reader->start) != NULL;
+}
+
+/**
+ * Makes room for at least readSize more bytes after the buffered data, first
+ * by moving the unread part of the buffer to its start and then, if that is
+ * not enough, by doubling the buffer.
+ */
+static void makeRoom(struct LineReader* reader)
+{
+  if (reader->start > 0) {
+    memmove(reader->buffer, reader->buffer + reader->start, reader->end - reader->start);
+    reader->end -= reader->start;
+    reader->start = 0;
+  }
+  while (reader->capacity - reader->end < reader->readSize + 1) {
+    reader->capacity *= 2;
+    reader->buffer = realloc(reader->buffer, reader->capacity);
+    assert(reader->buffer != 0);
+  }
+}
+
+/**
+ * Returns the next line, without its newline, and stores its length in
+ * *length. A last line that has no newline is still returned. Returns NULL
+ * at the end of the input or on a read error. At a terminal, the next call
+ * after that reads again.
+ */
+char* lineReaderNext(struct LineReader* reader, size_t* length)
+{
+  size_t scanned = reader->start;
+  char* newline;
+  char* line;
+  ssize_t count;
+
+  while ((newline = memchr(reader->buffer + scanned, '\n', reader->end - scanned)) == NULL) {
+    if (reader->eof) {
+      if (reader->start == reader->end) {
+        // A terminal can still be read after a ctrl-d ends one read
+        reader->eof = !reader->isTerminal;
+        return NULL;
+      }
+      // The terminator goes in the byte kept spare by makeRoom()
+      newline = reader->buffer + reader->end;
+      break;
+    }
+
+    // Only the new bytes need to be searched for a newline next time
+    scanned = reader->end - reader->start;
+    makeRoom(reader);
+    count = read(reader->fd, reader->buffer + reader->end, reader->readSize);
+    if (count == -1 && errno == EINTR) {
+      continue;
+    }
+    if (count <= 0) {
+      reader->eof = 1;
+    } else {
+      reader->end += count;
+    }
+  }
+
+  line = reader->buffer + reader->start;
+  *newline = '\0';
+  *length = newline - line;
+  reader->start = newline - reader->buffer;
+  if (reader->start < reader->end) {
+    reader->start++;
+  }
+  return line;
+}
@@ -0,0 +1,24 @@
+/*
+ * Filename: lineReader.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the line reader,
+ * which reads lines of any length from a file descriptor through a buffer
+ * that grows as needed.
+ */
+
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#include <stddef.h>
+
+struct LineReader;
+
+struct LineReader* lineReaderCreate(int fd);
+void lineReaderDestroy(struct LineReader* reader);
+
+/* The line returned is only valid until the next call to lineReaderNext().
+ */
+char* lineReaderNext(struct LineReader* reader, size_t* length);
+int lineReaderHasLine(struct LineReader* reader);
+
+#endif
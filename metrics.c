@@ -0,0 +1,76 @@
+/*
+ * Filename: metrics.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the shell's counters.
+ * Each one is a plain increment, plus a clock_gettime() for the ones that
+ * are timed, so they are always kept rather than switched on.
+ */
+
+#include "metrics.h"
+
+static struct Metrics metrics;
+
+/**
+ * Returns the number of microseconds since start on the monotonic clock.
+ */
+double metricsMicrosSince(const struct timespec* start)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1e6 + (now.tv_nsec - start->tv_nsec) / 1e3;
+}
+
+/**
+ * Adds a latency to a histogram.
+ */
+static void histogramAdd(struct Histogram* histogram, double micros)
+{
+  int bucket = 0;
+
+  while (bucket < METRICS_BUCKETS - 1 && micros >= (double)(1UL << bucket)) {
+    bucket++;
+  }
+  histogram->counts[bucket]++;
+  histogram->count++;
+  histogram->sumMicros += micros;
+}
+
+/**
+ * Counts a child launched (or not, if failed is set) by a call that began at
+ * start.
+ */
+void metricsCountSpawn(const struct timespec* start, int failed)
+{
+  if (failed) {
+    metrics.spawnFailures++;
+    return;
+  }
+  metrics.spawns++;
+  histogramAdd(&metrics.spawnLatency, metricsMicrosSince(start));
+}
+
+/**
+ * Counts a child reaped.
+ */
+void metricsCountReap()
+{
+  metrics.reaps++;
+}
+
+/**
+ * Counts a parse that began at start.
+ */
+void metricsCountParse(const struct timespec* start)
+{
+  metrics.parses++;
+  metrics.parseSeconds += metricsMicrosSince(start) / 1e6;
+}
+
+/**
+ * Returns the counters.
+ */
+const struct Metrics* metricsGet()
+{
+  return &metrics;
+}
@@ -0,0 +1,39 @@
+/*
+ * Filename: metrics.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the shell's
+ * counters of launches, reaps and parsing, which the control socket reports.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <time.h>
+
+#define METRICS_BUCKETS 24  // Powers of two from 1 microsecond to 4 seconds
+
+// A histogram of latencies in power-of-two buckets of microseconds
+struct Histogram
+{
+  unsigned long counts[METRICS_BUCKETS];  // Bucket i holds [2^(i-1), 2^i) us
+  unsigned long count;
+  double sumMicros;
+};
+
+struct Metrics
+{
+  unsigned long spawns;         // Children launched
+  unsigned long spawnFailures;  // Children that could not be launched
+  unsigned long reaps;          // Children reaped
+  unsigned long parses;         // Lines and pipelines parsed
+  double parseSeconds;          // Time spent parsing them
+  struct Histogram spawnLatency;  // Time taken to start each child
+};
+
+void metricsCountSpawn(const struct timespec* start, int failed);
+void metricsCountReap();
+void metricsCountParse(const struct timespec* start);
+const struct Metrics* metricsGet();
+double metricsMicrosSince(const struct timespec* start);
+
+#endif
@@ -0,0 +1,305 @@
+/*
+ * Filename: parallel.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the "parallel" built-in:
+ *
+ *   parallel [-j N] [-k] command words... [::: item...]
+ *
+ * The command is run once per item, with every "{}" in its words replaced by
+ * the item (or the item appended if there is no "{}"). Items come after
+ * ":::", or else one per line from the built-in's "<" file or from stdin.
+ * When the shell is reading its commands from stdin, the items are read
+ * through the shell's own line reader, which may already hold them, and
+ * the lines after them are run as commands once the input ends.
+ * Exactly N copies (by default, one per online CPU) are kept running; as
+ * soon as one exits the next item is launched. With -k, each item's output
+ * is held in a temporary file and written out in item order.
+ *
+ * The copies are launched like foreground pipelines, so they stay in the
+ * shell's process group and ctrl-c reaches them. Background jobs always get
+ * a process group of their own, so wait4(0) collects exactly the copies
+ * and never a background job. The running copies are tracked in a job
+ * table of their own.
+ */
+
+#define _GNU_SOURCE   // mkostemp()
+#include "parallel.h"
+#include "jobTable.h"
+#include "lineReader.h"
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/wait.h>
+
+// Output held back by -k until every earlier item has been written out
+struct HeldOutput
+{
+  int fd;       // Temporary file with the item's output, or -1
+  int done;
+};
+
+/**
+ * This function gets the next item, either from the words after ":::", from
+ * the next line of the shell's input, or from the next line of the item
+ * file. Returns NULL when there are none left. Lines are returned in a
+ * buffer that is reused for the next line.
+ */
+static char* nextItem(struct Command* command, int* nextArg, struct LineReader* input,
+                      FILE* itemFile, char** line, size_t* lineSize)
+{
+  ssize_t length;
+  size_t inputLength;
+
+  if (input != NULL) {
+    return lineReaderNext(input, &inputLength);
+  }
+  if (itemFile == NULL) {
+    if (*nextArg >= command->numArgs) {
+      return NULL;
+    }
+    (*nextArg)++;
+    return command->args[*nextArg - 1];
+  }
+
+  length = getline(line, lineSize, itemFile);
+  if (length == -1) {
+    return NULL;
+  }
+  if (length > 0 && (*line)[length - 1] == '\n') {
+    (*line)[length - 1] = '\0';
+  }
+  return *line;
+}
+
+/**
+ * This function builds the command line for one item from the template
+ * words, replacing each "{}" with the item. If no word contains "{}" the
+ * item is appended as the last word. Returns a newly allocated string.
+ */
+static char* buildLine(char** words, int numWords, const char* item)
+{
+  int itemLength = strlen(item);
+  int length = itemLength + 2;
+  int substituted = 0;
+  char* line;
+  char* out;
+  const char* in;
+
+  // Each "{}" can grow into the item, so size the line for the worst case
+  for (int i = 0; i < numWords; i++) {
+    length += strlen(words[i]) * (itemLength / 2 + 1) + 1;
+  }
+  line = malloc(length);
+  out = line;
+
+  for (int i = 0; i < numWords; i++) {
+    if (i > 0) {
+      *out++ = ' ';
+    }
+    for (in = words[i]; *in != '\0'; in++) {
+      if (in[0] == '{' && in[1] == '}') {
+        memcpy(out, item, itemLength);
+        out += itemLength;
+        in++;
+        substituted = 1;
+      } else {
+        *out++ = *in;
+      }
+    }
+  }
+  if (!substituted) {
+    *out++ = ' ';
+    memcpy(out, item, itemLength);
+    out += itemLength;
+  }
+  *out = '\0';
+  return line;
+}
+
+/**
+ * This function writes out, in item order, the held output of every item
+ * that has finished and has no unfinished item before it.
+ */
+static void writeHeldOutput(struct HeldOutput* held, int numItems, int* nextToWrite)
+{
+  char buffer[1 << 16];
+  ssize_t count;
+
+  fflush(stdout);
+  while (*nextToWrite < numItems && held[*nextToWrite].done) {
+    if (held[*nextToWrite].fd != -1) {
+      lseek(held[*nextToWrite].fd, 0, SEEK_SET);
+      while ((count = read(held[*nextToWrite].fd, buffer, sizeof(buffer))) > 0) {
+        write(STDOUT_FILENO, buffer, count);
+      }
+      close(held[*nextToWrite].fd);
+    }
+    (*nextToWrite)++;
+  }
+}
+
+/**
+ *  This function implements the "parallel" built-in described at the top of
+ *  this file. input is the reader the shell takes its commands from, or
+ *  NULL if they do not come from stdin.
+ *  Returns 0 if every item succeeded, otherwise the number of items that
+ *  failed (at most 101, as GNU parallel does), or 255 for a usage error.
+ */
+int runParallel(struct Command* command, struct LineReader* input)
+{
+  struct JobTable* running = NULL;
+  struct Job* job = NULL;
+  struct Pipeline* pipeline = NULL;
+  struct HeldOutput* held = NULL;
+  struct LineReader* itemReader = NULL;
+  FILE* itemFile = NULL;
+  char tempName[] = "/tmp/smallsh-parallel-XXXXXX";
+  char* line = NULL;
+  size_t lineSize = 0;
+  char* itemLine = NULL;
+  char* item = NULL;
+  int* itemOf = NULL;
+  int maxJobs = sysconf(_SC_NPROCESSORS_ONLN);
+  int keepOrder = 0;
+  int firstWord, numWords, nextArg;
+  int numItems = 0;
+  int heldCapacity = 0;
+  int nextToWrite = 0;
+  int failed = 0;
+  int stop = 0;
+  int status;
+  struct rusage usage;
+  pid_t pid;
+
+  // Options come before the command words
+  nextArg = 1;
+  while (nextArg < command->numArgs && command->args[nextArg][0] == '-') {
+    if (strcmp(command->args[nextArg], "-k") == 0) {
+      keepOrder = 1;
+    } else if (strcmp(command->args[nextArg], "-j") == 0
+               && nextArg + 1 < command->numArgs) {
+      nextArg++;
+      maxJobs = atoi(command->args[nextArg]);
+    } else if (strncmp(command->args[nextArg], "-j", 2) == 0) {
+      maxJobs = atoi(command->args[nextArg] + 2);
+    } else {
+      break;
+    }
+    nextArg++;
+  }
+
+  // The command words run up to ":::", after which the items are listed
+  firstWord = nextArg;
+  while (nextArg < command->numArgs && strcmp(command->args[nextArg], ":::") != 0) {
+    nextArg++;
+  }
+  numWords = nextArg - firstWord;
+  if (numWords == 0 || maxJobs < 1) {
+    printf("Usage: parallel [-j N] [-k] command [{}]... [::: item...]\n");
+    fflush(stdout);
+    return 255;
+  }
+
+  if (nextArg < command->numArgs) {
+    nextArg++;  // Skip ":::"
+  } else if (command->inputFile != NULL) {
+    itemFile = fopen(command->inputFile, "r");
+    if (itemFile == NULL) {
+      printf("cannot open %s for input\n", command->inputFile);
+      fflush(stdout);
+      return 1;
+    }
+  } else if (input != NULL) {
+    itemReader = input;
+  } else {
+    itemFile = stdin;
+  }
+
+  running = jobTableCreate();
+  // Job IDs are reused, so there are never more than maxJobs of them
+  itemOf = malloc((maxJobs + 1) * sizeof(int));
+
+  while (1) {
+    // Top the pool up to maxJobs running copies
+    while (!stop && jobTableSize(running) < maxJobs
+           && (item = nextItem(command, &nextArg, itemReader, itemFile, &itemLine, &lineSize)) != NULL) {
+      if (numItems == heldCapacity) {
+        heldCapacity = heldCapacity == 0 ? 64 : heldCapacity * 2;
+        held = realloc(held, heldCapacity * sizeof(struct HeldOutput));
+      }
+      held[numItems].fd = -1;
+      held[numItems].done = 1;
+
+      line = buildLine(command->args + firstWord, numWords, item);
+      pipeline = createPipeline(line);
+      free(line);
+      if (pipeline == NULL) {
+        failed++;
+        numItems++;
+        continue;
+      }
+
+      if (keepOrder && pipeline->stages[pipeline->numStages - 1]->outputFile == NULL) {
+        strcpy(tempName + strlen(tempName) - 6, "XXXXXX");
+        held[numItems].fd = mkostemp(tempName, O_CLOEXEC);
+        if (held[numItems].fd != -1) {
+          pipeline->stages[pipeline->numStages - 1]->outputFile = tempName;
+        }
+      }
+
+      if (launchPipeline(pipeline) != 0) {
+        failed++;
+        destroyPipeline(pipeline);
+      } else {
+        job = jobTableAdd(running, pipeline);
+        itemOf[job->id] = numItems;
+        held[numItems].done = 0;
+        destroyPipeline(pipeline);
+      }
+      // The child has the file open by now, so it can go from the directory
+      if (held[numItems].fd != -1) {
+        unlink(tempName);
+      }
+      numItems++;
+    }
+
+    if (keepOrder) {
+      writeHeldOutput(held, numItems, &nextToWrite);
+    }
+    if (jobTableSize(running) == 0) {
+      break;
+    }
+
+    // Wait for whichever copy finishes next
+    pid = wait4(0, &status, 0, &usage);
+    if (pid == -1) {
+      break;
+    }
+    job = jobTableFindPid(running, pid);
+    if (job == NULL) {
+      continue;
+    }
+    jobFinished(job, status, &usage);
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+      failed++;
+    }
+    // Like the rest of the shell, stop starting new work after a ctrl-c
+    if (WIFSIGNALED(status) && WTERMSIG(status) == SIGINT) {
+      stop = 1;
+    }
+    held[itemOf[job->id]].done = 1;
+    jobTableRemove(running, job);
+  }
+
+  if (itemFile != NULL && itemFile != stdin) {
+    fclose(itemFile);
+  }
+  free(itemLine);
+  free(itemOf);
+  free(held);
+  jobTableDestroy(running);
+  fflush(stdout);
+  return failed > 101 ? 101 : failed;
+}
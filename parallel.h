@@ -0,0 +1,17 @@
+/*
+ * Filename: parallel.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the "parallel"
+ * built-in, which runs a command once per item with a bounded number of
+ * copies running at a time.
+ */
+
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "command.h"
+#include "lineReader.h"
+
+int runParallel(struct Command* command, struct LineReader* input);
+
+#endif
@@ -0,0 +1,427 @@
+/*
+ * Filename: parseCache.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the parse cache, which
+ * spares a script that runs the same lines over and over from compiling and
+ * tokenizing them every time. It has two levels.
+ *
+ * Lines are looked up by their raw text in a hash table, and the plan each
+ * one compiled to is kept, up to a bounded number of lines (256 by default)
+ * with the least recently used line evicted first.
+ *
+ * Each step of a plan that has run successfully gets a pipeline template:
+ * the step parsed before expansion, with its internal pointers stored as
+ * offsets from the start of its allocation so that it can be copied
+ * anywhere, and with the slots of the words that contain a "$" marked. A
+ * step is then run by copying the template with one memcpy(), expanding
+ * the marked words (kept joined by spaces, so they take one call to
+ * variableExpand()) into space after the copy, and turning the offsets back
+ * into pointers; nothing is tokenized. Expansion can change how a line
+ * splits into words, so the template is not used when a marked word expands
+ * to nothing, to more than one word, or to a word that means something to
+ * the parser, such as "|" or "<"; the step is then expanded and parsed from
+ * scratch as usual.
+ */
+
+#define _GNU_SOURCE   // strchrnul()
+#include "parseCache.h"
+#include <assert.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#define DEFAULT_MAX_LINES 256
+
+struct CacheEntry
+{
+  char* line;
+  unsigned int hash;
+  struct Plan* plan;
+  struct CacheEntry* nextInBucket;
+  struct CacheEntry* newer;   // Neighbours in least recently used order
+  struct CacheEntry* older;
+};
+
+struct PipelineTemplate
+{
+  char* block;        // Copy of the parsed pipeline, with offsets for pointers
+  size_t size;
+  char* markedWords;  // The words to expand, joined by spaces
+  int numMarks;
+  size_t slots[];     // Offsets of the pointers to those words, in order
+};
+
+static struct CacheEntry** buckets = NULL;
+static int numBuckets = 0;  // Always a power of two
+static int numLines = 0;
+static int maxLines = DEFAULT_MAX_LINES;
+static struct CacheEntry* newest = NULL;
+static struct CacheEntry* oldest = NULL;
+static long lineHits = 0;
+static long lineMisses = 0;
+static long templateHits = 0;
+static long templateMisses = 0;
+
+/**
+ * FNV-1a hash of a line.
+ */
+static unsigned int hashLine(const char* line)
+{
+  unsigned int hash = 2166136261u;
+
+  while (*line != '\0') {
+    hash = (hash ^ (unsigned char)*line) * 16777619u;
+    line++;
+  }
+  return hash;
+}
+
+/**
+ * Takes an entry out of the least recently used list.
+ */
+static void unlinkEntry(struct CacheEntry* entry)
+{
+  if (entry->newer != NULL) {
+    entry->newer->older = entry->older;
+  } else {
+    newest = entry->older;
+  }
+  if (entry->older != NULL) {
+    entry->older->newer = entry->newer;
+  } else {
+    oldest = entry->newer;
+  }
+}
+
+/**
+ * Puts an entry at the most recently used end of the list.
+ */
+static void linkNewest(struct CacheEntry* entry)
+{
+  entry->newer = NULL;
+  entry->older = newest;
+  if (newest != NULL) {
+    newest->newer = entry;
+  } else {
+    oldest = entry;
+  }
+  newest = entry;
+}
+
+/**
+ * Drops the least recently used line from the cache.
+ */
+static void evictOldest()
+{
+  struct CacheEntry* entry = oldest;
+  struct CacheEntry** link = &buckets[entry->hash & (numBuckets - 1)];
+
+  while (*link != entry) {
+    link = &(*link)->nextInBucket;
+  }
+  *link = entry->nextInBucket;
+  unlinkEntry(entry);
+  planDestroy(entry->plan);
+  free(entry->line);
+  free(entry);
+  numLines--;
+}
+
+/**
+ * Sets the number of lines the cache keeps. The line being looked up is
+ * always kept, so 0 keeps just that one. Lines over the new limit are
+ * dropped.
+ */
+void parseCacheSetSize(int lines)
+{
+  maxLines = lines;
+  while (numLines > 0 && numLines > maxLines) {
+    evictOldest();
+  }
+}
+
+/**
+ *  This function returns the plan for the given line, compiling it on a
+ *  miss, and makes the line the most recently used. To keep the cache
+ *  within its size, the least recently used line is dropped first.
+ *  Returns NULL, caching nothing, if the line does not compile; *isOpen is
+ *  then set as planCompile() sets it.
+ */
+struct Plan* parseCacheLookup(const char* line, int* isOpen)
+{
+  unsigned int hash = hashLine(line);
+  struct CacheEntry* entry = NULL;
+  struct Plan* plan = NULL;
+
+  if (numBuckets == 0) {
+    // Size the table for the largest the cache can be, at most half full
+    numBuckets = 64;
+    while (numBuckets < 2 * maxLines && numBuckets < (1 << 20)) {
+      numBuckets *= 2;
+    }
+    buckets = calloc(numBuckets, sizeof(struct CacheEntry*));
+    assert(buckets != 0);
+  }
+
+  for (entry = buckets[hash & (numBuckets - 1)]; entry != NULL; entry = entry->nextInBucket) {
+    if (entry->hash == hash && strcmp(entry->line, line) == 0) {
+      lineHits++;
+      *isOpen = 0;
+      unlinkEntry(entry);
+      linkNewest(entry);
+      return entry->plan;
+    }
+  }
+
+  lineMisses++;
+  plan = planCompile(line, isOpen);
+  if (plan == NULL) {
+    return NULL;
+  }
+  while (numLines > 0 && numLines >= maxLines) {
+    evictOldest();
+  }
+  entry = malloc(sizeof(struct CacheEntry));
+  entry->line = strdup(line);
+  entry->hash = hash;
+  entry->plan = plan;
+  entry->nextInBucket = buckets[hash & (numBuckets - 1)];
+  buckets[hash & (numBuckets - 1)] = entry;
+  linkNewest(entry);
+  numLines++;
+  return plan;
+}
+
+/**
+ * Prints the number of lines cached and the cache's counters.
+ */
+void parseCachePrint()
+{
+  printf("parse cache: %d lines, %ld hits, %ld misses; %ld steps from templates, "
+         "%ld parsed instead\n", numLines, lineHits, lineMisses, templateHits, templateMisses);
+  fflush(stdout);
+}
+
+/**
+ * Turns a pointer into the pipeline's allocation into an offset from its
+ * start. NULL and pointers outside it, such as to the shared "/dev/null",
+ * are left as they are.
+ */
+static void* toOffset(const struct Pipeline* pipeline, void* pointer)
+{
+  if ((char*)pointer > (char*)pipeline && (char*)pointer < (char*)pipeline + pipeline->size) {
+    return (void*)((char*)pointer - (char*)pipeline);
+  }
+  return pointer;
+}
+
+/**
+ * Turns an offset back into a pointer into the allocation at base, which
+ * has the given size. Anything else is a pointer and is left as it is.
+ */
+static void* toPointer(char* base, size_t size, void* offset)
+{
+  if (offset != NULL && (uintptr_t)offset < size) {
+    return base + (uintptr_t)offset;
+  }
+  return offset;
+}
+
+/**
+ * Marks the slot at the given pointer if the word it points to contains a
+ * "$", adding the word to the ones to expand and growing the template as
+ * needed.
+ */
+static struct PipelineTemplate* markWord(struct PipelineTemplate* template,
+                                         const struct Pipeline* pipeline, char** slot,
+                                         int* capacity, struct Expansion* words)
+{
+  if (*slot == NULL || strchr(*slot, '$') == NULL) {
+    return template;
+  }
+  if (template->numMarks == *capacity) {
+    *capacity *= 2;
+    template = realloc(template, sizeof(struct PipelineTemplate)
+                                 + *capacity * sizeof(size_t));
+  }
+  template->slots[template->numMarks] = (char*)slot - (char*)pipeline;
+  template->numMarks++;
+  expansionAppend(words, " ", words->length > 0);
+  expansionAppend(words, *slot, strlen(*slot));
+  return template;
+}
+
+/**
+ *  This function makes a template from the text of one step of a plan,
+ *  before expansion. Launch modifiers are applied while parsing, so a step
+ *  that starts with them and has anything to expand gets no template.
+ *  Returns the template, or NULL if there is none.
+ */
+struct PipelineTemplate* templateCreate(const char* text)
+{
+  struct PipelineTemplate* template = NULL;
+  struct Pipeline* pipeline = NULL;
+  struct Pipeline* copy = NULL;
+  struct Command* stage = NULL;
+  struct Command* stageCopy = NULL;
+  char* textCopy = strdup(text);
+  int capacity = 4;
+  struct Expansion words;
+
+  if (text[strspn(text, " ")] == '@' && strchr(text, '$') != NULL) {
+    free(textCopy);
+    return NULL;
+  }
+  pipeline = createPipeline(textCopy);
+  free(textCopy);
+  if (pipeline == NULL) {
+    return NULL;
+  }
+
+  template = malloc(sizeof(struct PipelineTemplate) + capacity * sizeof(size_t));
+  template->numMarks = 0;
+  expansionInit(&words);
+  expansionAppend(&words, "", 0);
+  for (int i = 0; i < pipeline->numStages; i++) {
+    stage = pipeline->stages[i];
+    for (int j = 0; j < stage->numArgs; j++) {
+      template = markWord(template, pipeline, &stage->args[j], &capacity, &words);
+    }
+    template = markWord(template, pipeline, &stage->inputFile, &capacity, &words);
+    template = markWord(template, pipeline, &stage->outputFile, &capacity, &words);
+    template = markWord(template, pipeline, &stage->errorFile, &capacity, &words);
+  }
+  template->markedWords = words.text;
+
+  // Copy the pipeline, replacing every pointer into it with an offset
+  template->size = pipeline->size;
+  template->block = malloc(pipeline->size);
+  memcpy(template->block, pipeline, pipeline->size);
+  copy = (struct Pipeline*)template->block;
+  copy->stages = toOffset(pipeline, pipeline->stages);
+  for (int i = 0; i < pipeline->numStages; i++) {
+    stage = pipeline->stages[i];
+    stageCopy = (struct Command*)(template->block + ((char*)stage - (char*)pipeline));
+    ((struct Command**)(template->block + (uintptr_t)copy->stages))[i] = toOffset(pipeline, stage);
+    stageCopy->name = toOffset(pipeline, stage->name);
+    stageCopy->args = toOffset(pipeline, stage->args);
+    for (int j = 0; j < stage->numArgs; j++) {
+      ((char**)(template->block + (uintptr_t)stageCopy->args))[j] = toOffset(pipeline, stage->args[j]);
+    }
+    stageCopy->inputFile = toOffset(pipeline, stage->inputFile);
+    stageCopy->outputFile = toOffset(pipeline, stage->outputFile);
+    stageCopy->errorFile = toOffset(pipeline, stage->errorFile);
+  }
+  destroyPipeline(pipeline);
+  return template;
+}
+
+/**
+ * Frees a template.
+ */
+void templateDestroy(struct PipelineTemplate* template)
+{
+  if (template != NULL) {
+    free(template->block);
+    free(template->markedWords);
+    free(template);
+  }
+}
+
+/**
+ * Returns 1 if the given expanded word, which has no spaces, has no special
+ * meaning to the parser, and 0 otherwise.
+ */
+static int isPlainWord(const char* value)
+{
+  static const char* const special[] = {"|", "<", ">", ">>", "2>", "2>&1", "&"};
+
+  // Every special word starts with one of these characters
+  if (strchr("|<>2&@cnm", value[0]) == NULL) {
+    return 1;
+  }
+  if (value[0] == '\0' || value[0] == '@'
+      || strncmp(value, "cpu=", 4) == 0 || strncmp(value, "nice=", 5) == 0
+      || strncmp(value, "mem=", 4) == 0) {
+    return 0;
+  }
+  for (int i = 0; i < sizeof(special) / sizeof(special[0]); i++) {
+    if (strcmp(value, special[i]) == 0) {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+/**
+ *  This function makes a new pipeline from a template, as described at the
+ *  top of this file, expanding the marked words with the given variables.
+ *  The pipeline is a single allocation like one from createPipeline(), and
+ *  is freed with destroyPipeline().
+ *  Returns the pipeline, or NULL if the step must be parsed from scratch.
+ */
+struct Pipeline* templateInstantiate(const struct PipelineTemplate* template,
+                                     struct Expansion* scratch,
+                                     const struct ExpandVars* vars)
+{
+  size_t used = template->size;
+  size_t wordStart;
+  char* block = NULL;
+  char* words = NULL;
+  struct Pipeline* pipeline = NULL;
+  struct Command* stage = NULL;
+
+  // The expansion must split into exactly the marked words again
+  if (template->numMarks > 0) {
+    words = variableExpand(scratch, template->markedWords, vars);
+    used += scratch->length + 1;
+  }
+  block = malloc(used);
+  pipeline = (struct Pipeline*)block;
+  memcpy(block, template->block, template->size);
+  if (words != NULL) {
+    memcpy(block + template->size, words, scratch->length + 1);
+    words = block + template->size;
+  }
+
+  // Cut the expanded words apart, storing each one's offset in its slot
+  for (int i = 0; i < template->numMarks; i++) {
+    wordStart = words - block;
+    words = strchrnul(words, ' ');
+    if (*words == ' ') {
+      *words++ = '\0';
+    } else if (i < template->numMarks - 1) {
+      words = NULL;
+    }
+    if (words == NULL || !isPlainWord(block + wordStart)) {
+      free(block);
+      templateMisses++;
+      return NULL;
+    }
+    *(char**)(block + template->slots[i]) = (char*)(uintptr_t)wordStart;
+  }
+  if (words != NULL && *words != '\0') {
+    // A word expanded to more than one
+    free(block);
+    templateMisses++;
+    return NULL;
+  }
+
+  // Turn the offsets back into pointers
+  pipeline->size = used;
+  pipeline->stages = toPointer(block, used, pipeline->stages);
+  for (int i = 0; i < pipeline->numStages; i++) {
+    stage = pipeline->stages[i] = toPointer(block, used, pipeline->stages[i]);
+    stage->args = toPointer(block, used, stage->args);
+    for (int j = 0; j < stage->numArgs; j++) {
+      stage->args[j] = toPointer(block, used, stage->args[j]);
+    }
+    stage->name = stage->args[0];
+    stage->inputFile = toPointer(block, used, stage->inputFile);
+    stage->outputFile = toPointer(block, used, stage->outputFile);
+    stage->errorFile = toPointer(block, used, stage->errorFile);
+  }
+  templateHits++;
+  return pipeline;
+}
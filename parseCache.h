@@ -0,0 +1,31 @@
+/*
+ * Filename: parseCache.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the parse cache:
+ * the compiled plans of recently run lines, and the pipeline templates that
+ * let a step be run again without being tokenized. Like the path cache, it
+ * is shared by the whole process.
+ */
+
+#ifndef PARSE_CACHE_H
+#define PARSE_CACHE_H
+
+#include "plan.h"
+#include "command.h"
+#include "expand.h"
+
+void parseCacheSetSize(int maxLines);
+void parseCachePrint();
+
+/* The plan returned is owned by the cache, and is only valid until the next
+ * call to parseCacheLookup().
+ */
+struct Plan* parseCacheLookup(const char* line, int* isOpen);
+
+struct PipelineTemplate* templateCreate(const char* text);
+void templateDestroy(struct PipelineTemplate* template);
+struct Pipeline* templateInstantiate(const struct PipelineTemplate* template,
+                                     struct Expansion* scratch,
+                                     const struct ExpandVars* vars);
+
+#endif
@@ -0,0 +1,306 @@
+/*
+ * Filename: pathCache.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the cache of resolved
+ * command paths. Without it, every launch of a command that is not given as
+ * a path makes execvp() try each PATH directory in turn. The cache maps a
+ * command name to the absolute path it resolved to, in a linear-probing hash
+ * table. It is emptied whenever PATH changes, and an entry is dropped when
+ * its path no longer executes.
+ */
+
+#include "pathCache.h"
+#include <assert.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define INITIAL_SLOTS 64
+
+struct PathEntry
+{
+  char* name;       // NULL means the slot is empty
+  char* path;
+  int hits;
+};
+
+static struct PathEntry* slots = NULL;
+static int numSlots = 0;    // Always a power of two
+static int numEntries = 0;
+static char* cachedPath = NULL; // The value of PATH the entries belong to
+static long totalHits = 0;
+static long totalMisses = 0;
+
+/**
+ * FNV-1a hash of a command name.
+ */
+static unsigned int hashName(const char* name)
+{
+  unsigned int hash = 2166136261u;
+
+  while (*name != '\0') {
+    hash = (hash ^ (unsigned char)*name) * 16777619u;
+    name++;
+  }
+  return hash;
+}
+
+/**
+ * Returns the slot that holds the given name, or the empty slot where it
+ * would be inserted.
+ */
+static int findSlot(const char* name)
+{
+  int slot = hashName(name) & (numSlots - 1);
+
+  while (slots[slot].name != NULL && strcmp(slots[slot].name, name) != 0) {
+    slot = (slot + 1) & (numSlots - 1);
+  }
+  return slot;
+}
+
+/**
+ * Empties the given slot, shifting later entries of the same cluster back so
+ * that no lookup runs into the hole.
+ */
+static void clearSlot(int slot)
+{
+  int mask = numSlots - 1;
+  int next = (slot + 1) & mask;
+  int home;
+
+  free(slots[slot].name);
+  free(slots[slot].path);
+  slots[slot].name = NULL;
+  numEntries--;
+
+  while (slots[next].name != NULL) {
+    home = hashName(slots[next].name) & mask;
+    // Move the entry back if its home is not between the hole and itself
+    if (((next - home) & mask) >= ((next - slot) & mask)) {
+      slots[slot] = slots[next];
+      slots[next].name = NULL;
+      slot = next;
+    }
+    next = (next + 1) & mask;
+  }
+}
+
+/**
+ * Doubles the number of slots, or allocates the first ones.
+ */
+static void grow()
+{
+  struct PathEntry* oldSlots = slots;
+  int oldNumSlots = numSlots;
+
+  numSlots = numSlots == 0 ? INITIAL_SLOTS : numSlots * 2;
+  slots = calloc(numSlots, sizeof(struct PathEntry));
+  assert(slots != 0);
+
+  for (int i = 0; i < oldNumSlots; i++) {
+    if (oldSlots[i].name != NULL) {
+      slots[findSlot(oldSlots[i].name)] = oldSlots[i];
+    }
+  }
+  free(oldSlots);
+}
+
+/**
+ * Empties the cache if PATH is not what it was when the entries were made.
+ */
+static void checkPath()
+{
+  static char* defaultPath = NULL;
+  const char* path = getenv("PATH");
+  size_t length;
+
+  // Without PATH, search the system's default path as execvp() does
+  if (path == NULL) {
+    if (defaultPath == NULL) {
+      length = confstr(_CS_PATH, NULL, 0);
+      defaultPath = calloc(length + 1, 1);
+      assert(defaultPath != 0);
+      confstr(_CS_PATH, defaultPath, length);
+    }
+    path = defaultPath;
+  }
+  if (cachedPath != NULL && strcmp(cachedPath, path) == 0) {
+    return;
+  }
+  pathCacheClear();
+  free(cachedPath);
+  cachedPath = strdup(path);
+}
+
+/**
+ * Searches the PATH directories for an executable regular file with the
+ * given name. Returns a newly allocated path, or NULL if there isn't one.
+ * As with execvp(), an empty PATH entry means the current directory.
+ */
+static char* searchPath(const char* name)
+{
+  const char* dir = cachedPath;
+  const char* end;
+  int nameLen = strlen(name);
+  int dirLen;
+  char* candidate;
+  struct stat info;
+
+  while (1) {
+    end = strchr(dir, ':');
+    dirLen = end != NULL ? end - dir : (int)strlen(dir);
+
+    candidate = malloc(dirLen + nameLen + 3);
+    if (dirLen == 0) {
+      sprintf(candidate, "./%s", name);
+    } else {
+      sprintf(candidate, "%.*s/%s", dirLen, dir, name);
+    }
+    if (stat(candidate, &info) == 0 && S_ISREG(info.st_mode)
+        && access(candidate, X_OK) == 0) {
+      return candidate;
+    }
+    free(candidate);
+
+    if (end == NULL) {
+      return NULL;
+    }
+    dir = end + 1;
+  }
+}
+
+/**
+ * Searches PATH for the given command and, if it is found, adds it to the
+ * cache with the given number of uses. Returns the path, or NULL if the
+ * command was not found.
+ */
+static const char* insertEntry(const char* name, int hits)
+{
+  char* path = searchPath(name);
+  int slot;
+
+  static char* relativePath = NULL;
+
+  if (path == NULL) {
+    return NULL;
+  }
+
+  // A path found through an empty PATH entry is relative to the current
+  // directory, so it would be wrong after a cd; don't cache it
+  if (path[0] != '/') {
+    free(relativePath);
+    relativePath = path;
+    return path;
+  }
+
+  // Keep the table at most half full
+  if ((numEntries + 1) * 2 > numSlots) {
+    grow();
+  }
+  slot = findSlot(name);
+  slots[slot].name = strdup(name);
+  slots[slot].path = path;
+  slots[slot].hits = hits;
+  numEntries++;
+  return path;
+}
+
+/**
+ * Returns the path the given command should be executed from. A name that
+ * contains a "/" is already a path and is returned as is. Otherwise the
+ * cached path is returned, searching PATH and caching the result on a miss.
+ * cached is set to 1 if the path came from the cache, and to 0 if it was
+ * just found or the command was not found.
+ * Returns NULL if the command cannot be found.
+ */
+const char* pathCacheLookup(const char* name, int* cached)
+{
+  int slot;
+
+  *cached = 0;
+  if (strchr(name, '/') != NULL) {
+    return name;
+  }
+
+  checkPath();
+  if (numSlots > 0) {
+    slot = findSlot(name);
+    if (slots[slot].name != NULL) {
+      slots[slot].hits++;
+      totalHits++;
+      *cached = 1;
+      return slots[slot].path;
+    }
+  }
+
+  totalMisses++;
+  return insertEntry(name, 1);
+}
+
+/**
+ * Searches PATH for the given command again and caches the result without
+ * counting a use, as "hash name" does. Returns 0 on success or 1 if it was
+ * not found.
+ */
+int pathCacheAdd(const char* name)
+{
+  if (strchr(name, '/') != NULL) {
+    return 1;
+  }
+  checkPath();
+  pathCacheForget(name);
+  return insertEntry(name, 0) == NULL;
+}
+
+/**
+ * Drops the given command from the cache, e.g. because its cached path
+ * could not be executed.
+ */
+void pathCacheForget(const char* name)
+{
+  int slot;
+
+  if (numSlots == 0) {
+    return;
+  }
+  slot = findSlot(name);
+  if (slots[slot].name != NULL) {
+    clearSlot(slot);
+  }
+}
+
+/**
+ * Drops every entry from the cache. The hit and miss counters are kept.
+ */
+void pathCacheClear()
+{
+  for (int i = 0; i < numSlots; i++) {
+    if (slots[i].name != NULL) {
+      free(slots[i].name);
+      free(slots[i].path);
+      slots[i].name = NULL;
+    }
+  }
+  numEntries = 0;
+}
+
+/**
+ * Prints each cached command with its number of uses, followed by the
+ * cache's hit and miss counters.
+ */
+void pathCachePrint()
+{
+  if (numEntries > 0) {
+    printf("hits\tcommand\n");
+  }
+  for (int i = 0; i < numSlots; i++) {
+    if (slots[i].name != NULL) {
+      printf("%4d\t%s\n", slots[i].hits, slots[i].path);
+    }
+  }
+  printf("cache: %d entries, %ld hits, %ld misses\n", numEntries, totalHits, totalMisses);
+  fflush(stdout);
+}
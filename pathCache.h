@@ -0,0 +1,18 @@
+/*
+ * Filename: pathCache.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the cache of
+ * resolved command paths. Like PATH itself, the cache is shared by the whole
+ * process, so these functions operate on a single cache.
+ */
+
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+const char* pathCacheLookup(const char* name, int* cached);
+int pathCacheAdd(const char* name);
+void pathCacheForget(const char* name);
+void pathCacheClear();
+void pathCachePrint();
+
+#endif
@@ -0,0 +1,426 @@
+/*
+ * Filename: plan.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for execution plans. A line
+ * such as
+ *
+ *   make && ./test || echo failed ; cleanup
+ *
+ * is split into the text of each pipeline and the operator that joins it to
+ * the previous one. As in sh, "&&" and "||" have equal precedence and group
+ * from the left, so a list is flat: a step joined by "&&" is skipped if the
+ * last status was not 0, one joined by "||" is skipped if it was, and a
+ * skipped step leaves the status alone. Like "|", the operators must stand
+ * alone as words, except that ";" may also end a word. A "&" that stands
+ * alone ends a background pipeline, and the next one may follow it.
+ *
+ * A step can also be a loop, whose lists are compiled once into plans of
+ * their own:
+ *
+ *   for NAME in word...; do list; done
+ *   while list; do list; done
+ *
+ * "for", "while", "do" and "done" are only keywords as the first word of a
+ * step. A loop may be spread over several lines, which are joined with ";"
+ * before they are compiled.
+ *
+ * The steps are kept unexpanded, so that each one sees the $? left by the
+ * steps before it and a plan can be run more than once.
+ */
+
+#include "plan.h"
+#include "parseCache.h"
+#include <ctype.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+enum TokenKind
+{
+  TOKEN_WORD,
+  TOKEN_SEMICOLON,
+  TOKEN_AND,
+  TOKEN_OR,
+  TOKEN_AMPERSAND
+};
+
+struct Token
+{
+  enum TokenKind kind;
+  char* start;
+  int length;
+};
+
+struct Parser
+{
+  struct Token* tokens;
+  int numTokens;
+  int next;
+  int isOpen;     // Set when the tokens ran out inside a loop
+};
+
+/**
+ * Splits the line into tokens in place. A ";" at the end of a word becomes
+ * a token of its own. Returns the number of tokens.
+ */
+static int tokenize(char* line, struct Token* tokens)
+{
+  int numTokens = 0;
+  char* cursor = line;
+  struct Token* token;
+
+  while (1) {
+    while (*cursor == ' ') {
+      cursor++;
+    }
+    if (*cursor == '\0') {
+      return numTokens;
+    }
+    token = &tokens[numTokens++];
+    token->kind = TOKEN_WORD;
+    token->start = cursor;
+    while (*cursor != ' ' && *cursor != '\0') {
+      cursor++;
+    }
+    token->length = cursor - token->start;
+
+    if (token->length == 2 && strncmp(token->start, "&&", 2) == 0) {
+      token->kind = TOKEN_AND;
+    } else if (token->length == 2 && strncmp(token->start, "||", 2) == 0) {
+      token->kind = TOKEN_OR;
+    } else if (token->length == 1 && token->start[0] == '&') {
+      token->kind = TOKEN_AMPERSAND;
+    } else if (token->length == 1 && token->start[0] == ';') {
+      token->kind = TOKEN_SEMICOLON;
+    } else if (cursor[-1] == ';') {
+      token->length--;
+      token = &tokens[numTokens++];
+      token->kind = TOKEN_SEMICOLON;
+      token->start = cursor - 1;
+      token->length = 1;
+    }
+  }
+}
+
+/**
+ * Returns 1 if the parser's next token is the given word, and 0 otherwise.
+ */
+static int nextIsWord(struct Parser* parser, const char* word)
+{
+  struct Token* token = &parser->tokens[parser->next];
+
+  return parser->next < parser->numTokens && token->kind == TOKEN_WORD
+         && token->length == (int)strlen(word) && strncmp(token->start, word, token->length) == 0;
+}
+
+/**
+ * Prints a syntax error about the parser's next token, or about the end of
+ * the line if there are none left. Returns -1, for the caller to return.
+ */
+static int syntaxError(struct Parser* parser, const char* problem)
+{
+  struct Token* token = &parser->tokens[parser->next];
+
+  if (parser->next < parser->numTokens) {
+    printf("Error: %s at %.*s\n", problem, token->length, token->start);
+  } else {
+    printf("Error: %s at end of line\n", problem);
+  }
+  fflush(stdout);
+  return -1;
+}
+
+/**
+ * Cuts the text spanned by the given tokens out of the line, null-
+ * terminating it after the last one. Returns the text.
+ */
+static char* cutText(struct Token* first, struct Token* last)
+{
+  last->start[last->length] = '\0';
+  return first->start;
+}
+
+/**
+ * Allocates an empty plan, with room after it for the given number of
+ * bytes of text.
+ */
+static struct Plan* newPlan(size_t textSize)
+{
+  struct Plan* plan = malloc(sizeof(struct Plan) + textSize);
+
+  plan->steps = NULL;
+  plan->numSteps = 0;
+  plan->capacity = 0;
+  return plan;
+}
+
+/**
+ * Appends an empty step of the given kind to the plan, and returns it.
+ */
+static struct PlanStep* addStep(struct Plan* plan, enum PlanStepKind kind, int connector)
+{
+  struct PlanStep* step;
+
+  if (plan->numSteps == plan->capacity) {
+    plan->capacity = plan->capacity == 0 ? 4 : plan->capacity * 2;
+    plan->steps = realloc(plan->steps, plan->capacity * sizeof(struct PlanStep));
+  }
+  step = &plan->steps[plan->numSteps++];
+  memset(step, 0, sizeof(struct PlanStep));
+  step->kind = kind;
+  step->connector = connector;
+  return step;
+}
+
+static int parseList(struct Parser* parser, struct Plan* plan, const char* endWord);
+
+/**
+ * Parses the lists of a loop after its header, "do list; done", into a new
+ * plan for the body. Returns 0, or -1 on a syntax error.
+ */
+static int parseBody(struct Parser* parser, struct PlanStep* step)
+{
+  if (parser->next == parser->numTokens) {
+    parser->isOpen = 1;
+    return -1;
+  }
+  if (!nextIsWord(parser, "do")) {
+    return syntaxError(parser, "expected do");
+  }
+  parser->next++;
+  step->body = newPlan(0);
+  if (parseList(parser, step->body, "done") == -1) {
+    return -1;
+  }
+  if (step->body->numSteps == 0) {
+    return syntaxError(parser, "empty loop body");
+  }
+  parser->next++;   // "done"
+  return 0;
+}
+
+/**
+ * Parses "for NAME in word...;" after the "for", and then the loop's body.
+ * Returns 0, or -1 on a syntax error.
+ */
+static int parseFor(struct Parser* parser, struct PlanStep* step)
+{
+  struct Token* name = &parser->tokens[parser->next];
+  int firstWord;
+
+  if (parser->next == parser->numTokens) {
+    parser->isOpen = 1;
+    return -1;
+  }
+  if (name->kind != TOKEN_WORD || !(isalpha((unsigned char)name->start[0]) || name->start[0] == '_')) {
+    return syntaxError(parser, "expected a variable name");
+  }
+  for (int i = 1; i < name->length; i++) {
+    if (!isalnum((unsigned char)name->start[i]) && name->start[i] != '_') {
+      return syntaxError(parser, "expected a variable name");
+    }
+  }
+  parser->next++;
+  if (parser->next == parser->numTokens) {
+    parser->isOpen = 1;
+    return -1;
+  }
+  if (!nextIsWord(parser, "in")) {
+    return syntaxError(parser, "expected in");
+  }
+  parser->next++;
+
+  // The words run up to the ";", and are expanded when the loop starts
+  firstWord = parser->next;
+  while (parser->next < parser->numTokens
+         && parser->tokens[parser->next].kind == TOKEN_WORD) {
+    parser->next++;
+  }
+  if (parser->next == parser->numTokens) {
+    parser->isOpen = 1;
+    return -1;
+  }
+  if (parser->tokens[parser->next].kind != TOKEN_SEMICOLON) {
+    return syntaxError(parser, "expected ;");
+  }
+  step->text = "";
+  if (parser->next > firstWord) {
+    step->text = cutText(&parser->tokens[firstWord], &parser->tokens[parser->next - 1]);
+  }
+  step->variable = cutText(name, name);
+  while (parser->next < parser->numTokens
+         && parser->tokens[parser->next].kind == TOKEN_SEMICOLON) {
+    parser->next++;
+  }
+  return parseBody(parser, step);
+}
+
+/**
+ * Parses "list;" after the "while" into a plan for the condition, and then
+ * the loop's body. Returns 0, or -1 on a syntax error.
+ */
+static int parseWhile(struct Parser* parser, struct PlanStep* step)
+{
+  step->condition = newPlan(0);
+  if (parseList(parser, step->condition, "do") == -1) {
+    return -1;
+  }
+  if (step->condition->numSteps == 0) {
+    return syntaxError(parser, "missing condition");
+  }
+  return parseBody(parser, step);
+}
+
+/**
+ *  This function parses steps into the plan up to the given keyword, which
+ *  is left as the next token, or to the end of the line if there is none.
+ *  Empty steps between ";"s are dropped.
+ *  Returns 0, or -1 on a syntax error.
+ */
+static int parseList(struct Parser* parser, struct Plan* plan, const char* endWord)
+{
+  struct PlanStep* step = NULL;
+  struct Token* token = NULL;
+  int connector = PLAN_ALWAYS;
+  int background;
+  int first;
+
+  while (1) {
+    while (parser->next < parser->numTokens
+           && parser->tokens[parser->next].kind == TOKEN_SEMICOLON) {
+      if (connector != PLAN_ALWAYS) {
+        return syntaxError(parser, "missing command");
+      }
+      parser->next++;
+    }
+    if (parser->next == parser->numTokens) {
+      if (endWord != NULL) {
+        parser->isOpen = 1;
+        return -1;
+      }
+      if (connector != PLAN_ALWAYS) {
+        return syntaxError(parser, "missing command");
+      }
+      return 0;
+    }
+    if (endWord != NULL && nextIsWord(parser, endWord)) {
+      if (connector != PLAN_ALWAYS) {
+        return syntaxError(parser, "missing command");
+      }
+      return 0;
+    }
+
+    token = &parser->tokens[parser->next];
+    if (token->kind != TOKEN_WORD) {
+      return syntaxError(parser, "missing command");
+    }
+    if (nextIsWord(parser, "do") || nextIsWord(parser, "done")) {
+      return syntaxError(parser, "unexpected word");
+    }
+
+    background = 0;
+    if (nextIsWord(parser, "for") || nextIsWord(parser, "while")) {
+      parser->next++;
+      if (token->start[0] == 'f') {
+        step = addStep(plan, PLAN_FOR, connector);
+        if (parseFor(parser, step) == -1) {
+          return -1;
+        }
+      } else {
+        step = addStep(plan, PLAN_WHILE, connector);
+        if (parseWhile(parser, step) == -1) {
+          return -1;
+        }
+      }
+      if (parser->next < parser->numTokens
+          && parser->tokens[parser->next].kind == TOKEN_AMPERSAND) {
+        return syntaxError(parser, "loops cannot run in the background");
+      }
+    } else {
+      // A pipeline runs up to the next operator, and takes a "&" with it
+      first = parser->next;
+      while (parser->next < parser->numTokens
+             && parser->tokens[parser->next].kind == TOKEN_WORD) {
+        parser->next++;
+      }
+      if (parser->next < parser->numTokens
+          && parser->tokens[parser->next].kind == TOKEN_AMPERSAND) {
+        parser->next++;
+        background = 1;
+      }
+      step = addStep(plan, PLAN_PIPELINE, connector);
+      step->text = cutText(&parser->tokens[first], &parser->tokens[parser->next - 1]);
+    }
+
+    // What joins this step to the next
+    connector = PLAN_ALWAYS;
+    if (parser->next < parser->numTokens) {
+      token = &parser->tokens[parser->next];
+      if (token->kind == TOKEN_AND || token->kind == TOKEN_OR) {
+        connector = token->kind == TOKEN_AND ? PLAN_AND : PLAN_OR;
+        parser->next++;
+      } else if (token->kind == TOKEN_WORD && !background
+                 && !(endWord != NULL && nextIsWord(parser, endWord))) {
+        return syntaxError(parser, "expected ;");
+      }
+    }
+  }
+}
+
+/**
+ *  This function compiles a command line into a plan, as described at the
+ *  top of this file. The plan and a copy of the line are laid out in one
+ *  allocation, and the steps point into the copy.
+ *  Returns the plan, or NULL after printing a message if the line is not
+ *  valid. If the line ends inside a loop, *isOpen is set to 1 and NULL is
+ *  returned without a message, so that more lines can be added to it.
+ */
+struct Plan* planCompile(const char* line, int* isOpen)
+{
+  int length = strlen(line);
+  int maxTokens = 2;
+  struct Plan* plan = newPlan(length + 1);
+  char* text = (char*)(plan + 1);
+  struct Parser parser;
+  int result;
+
+  memcpy(text, line, length + 1);
+  // Each word can give a token and a ";"
+  for (const char* c = line; *c != '\0'; c++) {
+    maxTokens += 2 * (*c == ' ');
+  }
+  parser.tokens = malloc(maxTokens * sizeof(struct Token));
+  parser.numTokens = tokenize(text, parser.tokens);
+  parser.next = 0;
+  parser.isOpen = 0;
+
+  result = parseList(&parser, plan, NULL);
+  free(parser.tokens);
+  *isOpen = parser.isOpen;
+  if (result == -1) {
+    planDestroy(plan);
+    return NULL;
+  }
+  return plan;
+}
+
+/**
+ * Frees a plan, the plans of its loops and the templates of its steps.
+ */
+void planDestroy(struct Plan* plan)
+{
+  struct PlanStep* step;
+
+  for (int i = 0; i < plan->numSteps; i++) {
+    step = &plan->steps[i];
+    templateDestroy(step->template);
+    if (step->condition != NULL) {
+      planDestroy(step->condition);
+    }
+    if (step->body != NULL) {
+      planDestroy(step->body);
+    }
+  }
+  free(plan->steps);
+  free(plan);
+}
@@ -0,0 +1,52 @@
+/*
+ * Filename: plan.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for execution plans:
+ * a command line compiled into the list of pipelines and loops it runs and
+ * the ";", "&&" and "||" operators that join them.
+ */
+
+#ifndef PLAN_H
+#define PLAN_H
+
+// How a step is joined to the one before it
+enum PlanConnector
+{
+  PLAN_ALWAYS,    // ";" (or the first step): always run
+  PLAN_AND,       // "&&": run if the last status was 0
+  PLAN_OR         // "||": run if the last status was not 0
+};
+
+enum PlanStepKind
+{
+  PLAN_PIPELINE,  // text is the pipeline
+  PLAN_FOR,       // "for variable in text; do body; done"
+  PLAN_WHILE      // "while condition; do body; done"
+};
+
+struct PipelineTemplate;
+
+// One step of a command list, as written (its variables unexpanded)
+struct PlanStep
+{
+  enum PlanStepKind kind;
+  enum PlanConnector connector;
+  char* text;
+  char* variable;
+  struct Plan* condition;
+  struct Plan* body;
+  struct PipelineTemplate* template;  // Made once the step has run; see parseCache.c
+  int templateTried;
+};
+
+struct Plan
+{
+  struct PlanStep* steps;
+  int numSteps;
+  int capacity;
+};
+
+struct Plan* planCompile(const char* line, int* isOpen);
+void planDestroy(struct Plan* plan);
+
+#endif
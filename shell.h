@@ -0,0 +1,41 @@
+/*
+ * Filename: shell.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration file for the state of the shell that
+ * persists from one line to the next, shared by the main loop and the
+ * built-in commands.
+ */
+
+#ifndef SHELL_H
+#define SHELL_H
+
+#include "jobTable.h"
+#include "expand.h"
+#include "launchLimits.h"
+#include "lineReader.h"
+#include <sys/resource.h>
+
+struct Shell
+{
+  struct JobTable* bgJobs;  // Processes running in the background
+  char* shellPidStr;        // Our pid, for the expansion of $$
+  int sigFd;                // SIGCHLD signalfd
+  int fgOnly;               // Keep track of foreground only mode
+  int lastFgStatus;         // Keep track of the status of the last fg command
+  struct rusage lastFgUsage;  // Resources used by the last fg pipeline
+  double lastFgElapsed;       // and its wall-clock time in seconds
+  int exitOnError;          // -e: stop at the first command that fails
+  int exitRequested;        // Set by the "exit" built-in
+  pid_t lastBgPid;          // For the expansion of $!
+  struct Expansion expansion; // Buffer the current line is expanded into
+  struct LaunchLimits bgLimits; // Set by "limit" for background pipelines
+  const struct LoopVar* loopVars; // Variables of the loops now running
+  int interrupted;          // A foreground command was killed by ctrl-c
+  struct Expansion pending; // Lines of a loop that is not yet closed
+  struct LineReader* input; // Reads commands from stdin, or NULL with -c or a script
+};
+
+void reportJobDone(struct JobTable* jobs, struct Job* job, int status,
+                   const struct rusage* usage);
+
+#endif
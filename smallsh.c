@@ -2,7 +2,7 @@
  * Filename: smallsh.c
  * Author: Aaron Ennis
  * Email: ennisa@oregonstate.edu
- * Last modified: 5 November 2020
+ * Last modified: 16 October 2026
  * Description: This is the main implementation file for a Linux shell program
  * that implements a small subset of features akin to a more full-featured
  * shell like bash or csh. The purpose of this exercise is to demonstrate some
@@ -10,8 +10,20 @@
  * redirection. 
  */
 
-#include "linkedList.h"
+#include "shell.h"
+#include "builtins.h"
 #include "command.h"
+#include "expand.h"
+#include "lineReader.h"
+#include "zygote.h"
+#include "history.h"
+#include "plan.h"
+#include "parseCache.h"
+#include "capture.h"
+#include "eventLoop.h"
+#include "metrics.h"
+#include "control.h"
+#include "trace.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -19,36 +31,103 @@
 #include <unistd.h>
 #include <signal.h>
 #include <sys/wait.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <sys/signalfd.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <time.h>
 
 #define MAX_INPUT 2048
 
-int variableExpand(char* target, int targetMax, char* source, char token, char* replStr);
-void cleanUpBeforeExit(struct LinkedList* commands);
+
+int processLine(struct Shell* shell, char* userInput);
+int runPlan(struct Shell* shell, struct Plan* plan);
+int runFor(struct Shell* shell, struct PlanStep* step);
+int runWhile(struct Shell* shell, struct PlanStep* step);
+void discardPending(struct Shell* shell);
+int runPipeline(struct Shell* shell, struct PlanStep* step);
+int timeLine(struct Shell* shell, char* userInput);
+int runInteractive(struct Shell* shell);
+void openHistory();
+int runBatch(struct Shell* shell, const char* input, size_t length);
+int runScript(struct Shell* shell, const char* fileName);
+int reapBackground(int sigFd, struct JobTable* jobs);
+void serviceBackground(struct Shell* shell);
+void waitForInput(struct Shell* shell);
+const char* currentPrompt(struct Shell* shell);
+void cleanUpBeforeExit(struct JobTable* jobs);
 void handle_SIGTSTP(int sigNum);
 
-int main(int argc, char const *argv[])
+/**
+ *  Usage: smallsh [-e] [-c commands | script]
+ *  With no arguments the shell reads commands from stdin and prompts for
+ *  each one. With -c it runs the given commands, and with a script file
+ *  name it runs the file; neither prompts. -e makes the shell exit as soon
+ *  as a command fails.
+ */
+int main(int argc, char *argv[])
 {
   pid_t shellPid = getpid();
-  pid_t bgPid;
   char* shellPidStr = calloc(10, sizeof(char));
-  char userInput[MAX_INPUT];
-  char expandedInput[MAX_INPUT];
-  struct Command* myCommand = NULL;
-  struct Command* bgCommand = NULL;
+  char* commandString = NULL;
   // We'll need this to ignore signals under certain circumstances
   struct sigaction ignore = {{0}};
   // We'll use this to 
   struct sigaction toggleFGOnly = {{0}};
+  // SIGCHLD is blocked and read through a signalfd instead
+  sigset_t chldMask;
+  struct Shell shell;
+  int option;
+  int result;
 
-  // Use a linked list to keep track of processes running in the background,
-  // and initialize an iterator for it.
-  struct LinkedList* bgCommands = linkedListCreate();
+  shell.fgOnly = 0;
+  shell.lastFgStatus = 0;
+  memset(&shell.lastFgUsage, 0, sizeof(struct rusage));
+  shell.lastFgElapsed = 0;
+  shell.exitOnError = 0;
+  shell.exitRequested = 0;
+  shell.lastBgPid = 0;
+  expansionInit(&shell.expansion);
+  limitsClear(&shell.bgLimits);
+  shell.loopVars = NULL;
+  shell.interrupted = 0;
+  expansionInit(&shell.pending);
+  shell.input = NULL;
 
-  int fgOnly = 0;   // Keep track of foreground only mode
-  int lastFgStatus = 0; // Keep track of the status of the last fg command
+  while ((option = getopt(argc, argv, "+ec:")) != -1) {
+    switch (option) {
+      case 'e':
+        shell.exitOnError = 1;
+        break;
+      case 'c':
+        commandString = optarg;
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-e] [-c commands | script]\n", argv[0]);
+        return 2;
+    }
+  }
+
+  // Keep track of processes running in the background in a job table
+  // indexed by pid and by job ID.
+  shell.bgJobs = jobTableCreate();
+
+  // SMALLSH_PARSE_CACHE sets how many recent lines keep their parse
+  if (getenv("SMALLSH_PARSE_CACHE") != NULL) {
+    parseCacheSetSize(atoi(getenv("SMALLSH_PARSE_CACHE")));
+  }
+
+  // SMALLSH_CAPTURE keeps that many bytes of each background job's output
+  if (getenv("SMALLSH_CAPTURE") != NULL) {
+    captureSetSize(strtoul(getenv("SMALLSH_CAPTURE"), NULL, 10));
+  }
 
   // Convert smallsh pid to string for use in variable expansion
   sprintf(shellPidStr, "%d", shellPid);
+  shell.shellPidStr = shellPidStr;
 
   // Register a signal handler to ignore SIGINT/ctrl-c by default
   // We will set custom behavior for this signal for foreground commands
@@ -63,172 +142,671 @@ int main(int argc, char const *argv[])
   sigfillset(&toggleFGOnly.sa_mask);
   toggleFGOnly.sa_flags = SA_RESTART;
   sigaction(SIGTSTP, &toggleFGOnly, NULL);
-  
+
+  // With SMALLSH_ZYGOTE set, commands are launched by a helper forked now,
+  // while the shell is small; see zygote.c
+  if (getenv("SMALLSH_ZYGOTE") != NULL && zygoteStart() == -1) {
+    perror("zygote");
+  }
+
+  // SMALLSH_TRACE records the time of each phase of every line; see trace.c
+  if (getenv("SMALLSH_TRACE") != NULL) {
+    traceOpen(getenv("SMALLSH_TRACE"),
+              getenv("SMALLSH_TRACE_EVENTS") != NULL ? atoi(getenv("SMALLSH_TRACE_EVENTS")) : 0);
+  }
+
+  // Background completions are delivered as SIGCHLD on a signalfd, so the
+  // shell only calls wait4() when a child has actually exited.
+  sigemptyset(&chldMask);
+  sigaddset(&chldMask, SIGCHLD);
+  sigprocmask(SIG_BLOCK, &chldMask, NULL);
+  shell.sigFd = signalfd(-1, &chldMask, SFD_NONBLOCK | SFD_CLOEXEC);
+
+  // SMALLSH_CONTROL names a socket on which the shell answers queries about
+  // its jobs and counters; see control.c
+  if (getenv("SMALLSH_CONTROL") != NULL) {
+    controlStart(getenv("SMALLSH_CONTROL"), shell.bgJobs);
+  }
+
+  if (commandString != NULL) {
+    result = runBatch(&shell, commandString, strlen(commandString));
+  } else if (optind < argc) {
+    result = runScript(&shell, argv[optind]);
+  } else {
+    result = runInteractive(&shell);
+  }
+
+  controlStop();
+  traceClose();
+  cleanUpBeforeExit(shell.bgJobs);
+  zygoteStop();
+  close(shell.sigFd);
+  expansionFree(&shell.expansion);
+  expansionFree(&shell.pending);
+
+  free (shellPidStr);
+  return result;
+}
+
+/**
+ *  This function reads commands from stdin, displaying a prompt for each
+ *  one, until the "exit" built-in is run or the input ends.
+ *  Returns the shell's exit status.
+ */
+int runInteractive(struct Shell* shell)
+{
+  struct LineReader* reader = lineReaderCreate(STDIN_FILENO);
+  char* userInput;
+  char* recalled = NULL;
+  size_t length;
+  int exitNow;
+
+  openHistory();
+  // "parallel" reads its items through the same reader
+  shell->input = reader;
 
   while(1) {
     
-    printf(": ");   // Display the command prompt
+    // Report anything that finished while the last command ran
+    serviceBackground(shell);
+
+    // Display the command prompt, or "> " while a loop is being written
+    printf("%s", currentPrompt(shell));
     fflush(stdout);
-    fgets(userInput, MAX_INPUT, stdin);       // Get user input
-    userInput[strlen(userInput) - 1] = '\0';  // Remove the newline character
-      
-    // Keep processing the commands as long as a comment or a blank line is
-    // entered. Otherwise, just loop back and display the prompt.
-    if (userInput[0] != '\0' && userInput[0] != '#') {
-      if (variableExpand(expandedInput, MAX_INPUT, userInput, '$', shellPidStr)) {
-        myCommand = createCommand(expandedInput);
-      }
-      // Handle commands
-      if (strcmp(myCommand->name, "exit") == 0) {
-      // Handle built-in "exit" command
-        destroyCommand(myCommand);
-        break;
-      } else if (strcmp(myCommand->name, "cd") == 0) {
-      // Handle built-in "cd" command
-        if (myCommand->numArgs == 1) {
-        // "cd" is entered with no arguments
-          chdir(getenv("HOME"));
-        } else {
-          chdir(myCommand->args[1]);
-        }
-        destroyCommand(myCommand); 
-      } else if (strcmp(myCommand->name, "status") == 0) {
-      // Handle built-in "status" command
-        if (lastFgStatus > 1) {
-          printf("terminated by signal %d\n", lastFgStatus);
-          fflush(stdout);
-        } else {
-          printf("exit value %d\n", lastFgStatus);
-          fflush(stdout);
-        }
-      } else {
-        if (myCommand->runScope == 1 && fgOnly == 0) {
-        // Keep track of the command since it's going to run in the background
-          linkedListAddFront(bgCommands, myCommand);
-          executeCommand(myCommand, fgOnly);
-        } else {
-        // Otherwise, run it and destroy it immediately as a foreground process
-        lastFgStatus = executeCommand(myCommand, fgOnly);
-        destroyCommand(myCommand);
-        }
-      }
+    if (!lineReaderHasLine(reader)) {
+      waitForInput(shell);
+    }
+    TRACE_BEGIN(TRACE_READ);
+    userInput = lineReaderNext(reader, &length);  // Get user input
+    TRACE_END(TRACE_READ, 0);
+    if (userInput == NULL) {
+      // End of input works like "exit"
+      printf("\n");
+      fflush(stdout);
+      break;
     }
-    // Iterate through the list of background commands.
-    struct Iterator* iterator = createIterator(bgCommands);
-    while(iteratorHasNext(iterator)) {
-      bgCommand = iteratorNext(iterator);
-      bgPid = waitpid(bgCommand->myPid, &bgCommand->exitStatus, WNOHANG);
-      // If the return value for waitpid() is 0, the pid has not terminated.
-      // Otherwise, the pid itself will return if it has terminated...
-      if (bgPid != 0) {
-        if (WIFEXITED(bgCommand->exitStatus)) {
-            printf("background pid %d is done: exit value %d\n", bgCommand->myPid, bgCommand->exitStatus);
-            fflush(stdout);
-            // Free this command and remove it from the list
-            destroyCommand(bgCommand);
-            iteratorRemove(iterator);    
-          } else {
-            printf("background pid %d is done: terminated by signal %d\n", bgCommand->myPid, bgCommand->exitStatus);
-            fflush(stdout);
-            // Free this command and remove it from the list
-            destroyCommand(bgCommand);
-            iteratorRemove(iterator);
-          }
+
+    // Recall a history entry, showing what is being run
+    if (userInput[0] == '!' && userInput[1] != '\0') {
+      recalled = historyExpand(userInput);
+      if (recalled == NULL) {
+        continue;
       }
+      printf("%s\n", recalled);
+      userInput = recalled;
+    }
+    if (userInput[strspn(userInput, " ")] != '\0') {
+      historyAdd(userInput);
+    }
+
+    exitNow = processLine(shell, userInput);
+    free(recalled);
+    recalled = NULL;
+    if (exitNow) {
+      break;
     }
-    iteratorDestroy(iterator);  // Remove the iterator for next loop
-    fflush(stdin);
   }
+  discardPending(shell);
+  shell->input = NULL;
+  lineReaderDestroy(reader);
+  historyClose();
+  return shell->lastFgStatus;
+}
 
-  cleanUpBeforeExit(bgCommands);
+/**
+ *  This function opens the history file named by SMALLSH_HISTFILE, or
+ *  ~/.smallsh_history by default. A new file gets room for SMALLSH_HISTSIZE
+ *  entries, 65536 by default. If it cannot be opened the shell runs without
+ *  history.
+ */
+void openHistory()
+{
+  char* fileName = getenv("SMALLSH_HISTFILE");
+  char* sizeStr = getenv("SMALLSH_HISTSIZE");
+  char* home = getenv("HOME");
+  char* defaultName = NULL;
+  long numEntries = 65536;
 
-  free (shellPidStr);
-  return 0;
+  if (fileName == NULL) {
+    if (home == NULL) {
+      return;
+    }
+    defaultName = malloc(strlen(home) + sizeof("/.smallsh_history"));
+    sprintf(defaultName, "%s/.smallsh_history", home);
+    fileName = defaultName;
+  }
+  if (sizeStr != NULL && atol(sizeStr) > 0) {
+    numEntries = atol(sizeStr);
+  }
+  if (fileName[0] != '\0' && historyOpen(fileName, numEntries) == -1) {
+    printf("history: cannot open %s\n", fileName);
+    fflush(stdout);
+  }
+  free(defaultName);
 }
 
-void handle_SIGTSTP(int sigNum) {
-  char* message = "\nEntering foreground-only mode (& is now ignored)\n";
-  write(STDOUT_FILENO, message, 50);
+/**
+ *  This function runs every line of the given buffer as a command, without
+ *  prompting. stdout is left fully buffered; it is still flushed before
+ *  every command is launched, so output stays in order.
+ *  Returns the status of the last command, or the status of the failing
+ *  command when -e stops the run.
+ */
+int runBatch(struct Shell* shell, const char* input, size_t length)
+{
+  static char stdoutBuffer[1 << 16];
+  char* userInput = malloc(MAX_INPUT);
+  size_t inputSize = MAX_INPUT;
+  const char* end = input + length;
+  const char* newline;
+  size_t lineLength;
+
+  setvbuf(stdout, stdoutBuffer, _IOFBF, sizeof(stdoutBuffer));
+
+  while (input < end) {
+    newline = memchr(input, '\n', end - input);
+    lineLength = (newline != NULL ? newline : end) - input;
+
+    serviceBackground(shell);
+
+    // The input may be read-only, so each line is copied to terminate it
+    TRACE_BEGIN(TRACE_READ);
+    if (lineLength >= inputSize) {
+      inputSize = lineLength + 1;
+      userInput = realloc(userInput, inputSize);
+    }
+    memcpy(userInput, input, lineLength);
+    userInput[lineLength] = '\0';
+    TRACE_END(TRACE_READ, 0);
+    if (processLine(shell, userInput)) {
+      break;
+    }
+    if (shell->exitOnError && shell->lastFgStatus != 0) {
+      break;
+    }
+    input += lineLength + 1;
+  }
+
+  discardPending(shell);
+  free(userInput);
   fflush(stdout);
+  return shell->lastFgStatus;
+}
+
+/**
+ *  This function maps the given script file into memory and runs it with
+ *  runBatch(), so the file is read without any per-line system calls.
+ *  Returns the status of the script, or 1 if it could not be opened.
+ */
+int runScript(struct Shell* shell, const char* fileName)
+{
+  struct stat info;
+  char* contents;
+  int scriptFD = open(fileName, O_RDONLY | O_CLOEXEC);
+  int result;
+
+  if (scriptFD == -1 || fstat(scriptFD, &info) == -1) {
+    perror(fileName);
+    return 1;
+  }
+  if (info.st_size == 0) {
+    close(scriptFD);
+    return 0;
+  }
+
+  contents = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, scriptFD, 0);
+  close(scriptFD);
+  if (contents == MAP_FAILED) {
+    perror(fileName);
+    return 1;
+  }
+  madvise(contents, info.st_size, MADV_SEQUENTIAL);
+
+  result = runBatch(shell, contents, info.st_size);
+  munmap(contents, info.st_size);
+  return result;
+}
+
+/**
+ *  This function runs a single line of input. Comments and blank lines are
+ *  skipped; otherwise the plan of pipelines and loops joined by ";", "&&"
+ *  and "||" that the line compiles to (see plan.c) is run. Plans come from
+ *  the parse cache, so a line that is run again is not compiled again. A
+ *  line that ends inside a loop is held until the lines after it close the
+ *  loop.
+ *  Returns 1 if the shell should exit, and 0 otherwise.
+ */
+int processLine(struct Shell* shell, char* userInput)
+{
+  struct Plan* plan = NULL;
+  struct timespec parseStart;
+  int isOpen;
+
+  // Keep processing the commands as long as a comment or a blank line is
+  // entered. Otherwise, just loop back and display the prompt.
+  if (userInput[0] == '\0' || userInput[0] == '#') {
+    return 0;
+  }
+  if (shell->pending.length > 0) {
+    // The line continues a loop; lines are joined as if by ";"
+    expansionAppend(&shell->pending, "; ", 2);
+    expansionAppend(&shell->pending, userInput, strlen(userInput));
+    userInput = shell->pending.text;
+  } else if (strncmp(userInput, "time ", 5) == 0) {
+    // "time" applies to the rest of the line, whatever it is
+    return timeLine(shell, userInput + 5);
+  }
+  TRACE_BEGIN(TRACE_PLAN);
+  clock_gettime(CLOCK_MONOTONIC, &parseStart);
+  plan = parseCacheLookup(userInput, &isOpen);
+  metricsCountParse(&parseStart);
+  TRACE_END(TRACE_PLAN, 0);
+  if (plan == NULL) {
+    if (isOpen && shell->pending.length == 0) {
+      expansionAppend(&shell->pending, userInput, strlen(userInput));
+    } else if (!isOpen) {
+      shell->pending.length = 0;
+      shell->lastFgStatus = 1;
+    }
+    return 0;
+  }
+  shell->pending.length = 0;
+  shell->interrupted = 0;
+  return runPlan(shell, plan);
+}
+
+/**
+ *  This function drops the lines of a loop that the input ended before
+ *  closing, and reports it as an error.
+ */
+void discardPending(struct Shell* shell)
+{
+  if (shell->pending.length > 0) {
+    printf("Error: missing done at end of input\n");
+    fflush(stdout);
+    shell->pending.length = 0;
+    shell->lastFgStatus = 1;
+  }
+}
+
+/**
+ *  This function runs each step of a plan in turn, skipping a step joined
+ *  by "&&" when the last foreground status is not 0 and one joined by "||"
+ *  when it is. It stops early if a step asks the shell to exit, or if a
+ *  foreground command was killed by ctrl-c.
+ *  Returns 1 if the shell should exit, and 0 otherwise.
+ */
+int runPlan(struct Shell* shell, struct Plan* plan)
+{
+  struct PlanStep* step = NULL;
+  int exitNow = 0;
+
+  for (int i = 0; i < plan->numSteps && !exitNow && !shell->interrupted; i++) {
+    step = &plan->steps[i];
+    if ((step->connector == PLAN_AND && shell->lastFgStatus != 0)
+        || (step->connector == PLAN_OR && shell->lastFgStatus == 0)) {
+      continue;
+    }
+    switch (step->kind) {
+      case PLAN_PIPELINE:
+        exitNow = runPipeline(shell, step);
+        break;
+      case PLAN_FOR:
+        exitNow = runFor(shell, step);
+        break;
+      case PLAN_WHILE:
+        exitNow = runWhile(shell, step);
+        break;
+    }
+  }
+  return exitNow;
 }
 
 /**
- *  This function takes a pointer to a target string, an int representing the
- *  maximum size of the target string, a pointer to a source string, a char,
- *  and a pointer to a replacement string. It then copies the source into the
- *  target one character at a time. If it detects two token characters in a
- *  row, it copies the replacement string into the target string instead of
- *  the double token.
- *  If the length of the target is exceeded due to this expansion, an error
- *  message is displayed and the function returns 0. If successful, the
- *  function returns 1.
+ *  This function runs a "for" loop. Its words are expanded once, when the
+ *  loop starts, and split at spaces; the body is then run with the loop
+ *  variable set to each word in turn. Background jobs that finish are
+ *  reported between iterations.
+ *  The status is that of the last command of the body, or 0 if the body
+ *  never ran.
+ *  Returns 1 if the shell should exit, and 0 otherwise.
  */
-int variableExpand(char* target, int targetMax, char* source, char token, char* replStr)
+int runFor(struct Shell* shell, struct PlanStep* step)
 {
-  int targetLen = 0;
-  int replStrLen = strlen(replStr);
+  struct ExpandVars vars = {shell->shellPidStr, shell->lastFgStatus, shell->lastBgPid,
+                            shell->loopVars};
+  struct LoopVar variable = {step->variable, NULL, shell->loopVars};
+  char* words = strdup(variableExpand(&shell->expansion, step->text, &vars));
+  char* saveptr;
+  int status = 0;
+  int exitNow = 0;
+
+  shell->loopVars = &variable;
+  variable.value = strtok_r(words, " ", &saveptr);
+  while (variable.value != NULL && !exitNow && !shell->interrupted) {
+    exitNow = runPlan(shell, step->body);
+    status = shell->lastFgStatus;
+    serviceBackground(shell);
+    variable.value = strtok_r(NULL, " ", &saveptr);
+  }
+  shell->loopVars = variable.outer;
+  shell->lastFgStatus = status;
+  free(words);
+  return exitNow;
+}
+
+/**
+ *  This function runs a "while" loop: the condition, then the body if the
+ *  condition's status was 0, until it is not. Background jobs that finish
+ *  are reported between iterations.
+ *  The status is that of the last command of the body, or 0 if the body
+ *  never ran.
+ *  Returns 1 if the shell should exit, and 0 otherwise.
+ */
+int runWhile(struct Shell* shell, struct PlanStep* step)
+{
+  int status = 0;
+  int exitNow = 0;
+
+  while (1) {
+    exitNow = runPlan(shell, step->condition);
+    if (exitNow || shell->interrupted || shell->lastFgStatus != 0) {
+      break;
+    }
+    exitNow = runPlan(shell, step->body);
+    status = shell->lastFgStatus;
+    serviceBackground(shell);
+    if (exitNow || shell->interrupted) {
+      break;
+    }
+  }
+  shell->lastFgStatus = status;
+  return exitNow;
+}
+
+/**
+ *  This function runs one step of a plan: the text is expanded and parsed,
+ *  and run as a built-in or as a pipeline, in the foreground or the
+ *  background, and the shell's status is updated. Once a step has parsed
+ *  successfully it gets a template, which later runs copy instead of
+ *  parsing it again whenever expansion leaves the words the same.
+ *  Returns 1 if the shell should exit, and 0 otherwise.
+ */
+int runPipeline(struct Shell* shell, struct PlanStep* step)
+{
+  struct ExpandVars vars = {shell->shellPidStr, shell->lastFgStatus, shell->lastBgPid,
+                            shell->loopVars};
+  struct Pipeline* myPipeline = NULL;
+  struct Command* myCommand = NULL;
+  const struct Builtin* builtin = NULL;
+  struct JobTable* bgJobs = shell->bgJobs;
+  struct timespec parseStart;
+  char* expanded;
+  int result;
 
-  // Loop through the entire source string
-  while (*source != '\0') {
-    // If we've exceeded the target size, print and error and return failure
-    if (targetLen >= targetMax) {
-      printf("Error: Target length exceeded; cannot expand. Command failed.");
+  clock_gettime(CLOCK_MONOTONIC, &parseStart);
+  if (step->template != NULL) {
+    TRACE_BEGIN(TRACE_INSTANTIATE);
+    myPipeline = templateInstantiate(step->template, &shell->expansion, &vars);
+    TRACE_END(TRACE_INSTANTIATE, 0);
+  }
+  if (myPipeline == NULL) {
+    TRACE_BEGIN(TRACE_EXPAND);
+    expanded = variableExpand(&shell->expansion, step->text, &vars);
+    TRACE_END(TRACE_EXPAND, 0);
+    TRACE_BEGIN(TRACE_PARSE);
+    myPipeline = createPipeline(expanded);
+    TRACE_END(TRACE_PARSE, 0);
+    if (myPipeline == NULL) {
+      shell->lastFgStatus = 1;
       return 0;
     }
-    if (*source != token) {
-    // If the source character isn't a token, copy to target and increment
-      *target = *source;
-      target++;
-      source++;
-      targetLen++;
-    } else {
-    // Otherwise, the current char in source is a token.
-      if (*(source + 1) == token) {
-      // If the next char is also a token, copy the replacement string into
-      // target and advance pointers and counters
-        for (int i = 0; i < replStrLen; i++) {
-          *target = *replStr;
-          target++;
-          replStr++;
-          targetLen++;
-        }
-        source += 2;
-        replStr -= replStrLen;
+    if (!step->templateTried) {
+      step->templateTried = 1;
+      step->template = templateCreate(step->text);
+    }
+  }
+  metricsCountParse(&parseStart);
+  // Background pipelines get the "limit" defaults for anything their own
+  // modifiers leave unset
+  if (myPipeline->runScope == 1 && shell->fgOnly == 0) {
+    limitsMerge(&myPipeline->limits, &shell->bgLimits);
+  }
+  // Built-ins are only recognized as a command on their own, and utilities
+  // like echo are run as programs in the background or under launch limits
+  myCommand = myPipeline->stages[0];
+  if (myPipeline->numStages == 1) {
+    builtin = builtinLookup(myCommand->name);
+  }
+  if (builtin != NULL && (builtin->flags & BUILTIN_UTILITY)
+      && ((myPipeline->runScope == 1 && shell->fgOnly == 0)
+          || !limitsEmpty(&myPipeline->limits))) {
+    builtin = NULL;
+  }
+  // Handle commands
+  if (builtin != NULL) {
+    result = runBuiltin(builtin, shell, myCommand);
+    if (!(builtin->flags & BUILTIN_NO_STATUS)) {
+      shell->lastFgStatus = result;
+      memset(&shell->lastFgUsage, 0, sizeof(struct rusage));
+      shell->lastFgElapsed = 0;
+    }
+    destroyPipeline(myPipeline);
+  } else {
+    if (myPipeline->runScope == 1 && shell->fgOnly == 0) {
+    // Keep track of the pipeline since it's going to run in the background
+      myPipeline->captureFD = captureBegin();
+      result = executePipeline(myPipeline, shell->fgOnly);
+      if (myPipeline->captureFD != -1) {
+        close(myPipeline->captureFD);
+        myPipeline->captureFD = -1;
+      }
+      if (result == 0) {
+        shell->lastBgPid = myPipeline->myPid;
+        captureCommit(jobTableAdd(bgJobs, myPipeline)->id, shell->lastBgPid);
       } else {
-      // The next char in source is not also a token, so copy the single
-      // token into target and increment
-        *target = *source;
-        target++;
-        source++;
-        targetLen++;
+        captureCancel();
+        shell->lastFgStatus = 1;
       }
+      // The job table keeps a compact record of the job instead
+      destroyPipeline(myPipeline);
+    } else {
+    // Otherwise, run it and destroy it immediately in the foreground
+    shell->lastFgStatus = executePipeline(myPipeline, shell->fgOnly);
+    if (WIFSIGNALED(myPipeline->exitStatus) && WTERMSIG(myPipeline->exitStatus) == SIGINT) {
+      shell->interrupted = 1;
+    }
+    shell->lastFgUsage = myPipeline->usage;
+    shell->lastFgElapsed = pipelineElapsed(myPipeline);
+    destroyPipeline(myPipeline);
     }
   }
-  // Need to null-term target since we are doing char-by-char copy
-  *target = '\0';
-  return 1;
+  return shell->exitRequested;
 }
 
+void handle_SIGTSTP(int sigNum) {
+  char* message = "\nEntering foreground-only mode (& is now ignored)\n";
+  write(STDOUT_FILENO, message, 50);
+  fflush(stdout);
+}
+
+/**
+ *  This function implements the "time" built-in: it runs the rest of the
+ *  line and then reports the wall-clock time it took and the user and
+ *  system CPU time used by the shell and every child it waited for.
+ *  Returns whatever processLine() returns for the rest of the line.
+ */
+int timeLine(struct Shell* shell, char* userInput)
+{
+  struct rusage selfBefore, selfAfter, childBefore, childAfter;
+  struct timespec start, end;
+  struct timeval user, sys, delta;
+  int result;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  getrusage(RUSAGE_SELF, &selfBefore);
+  getrusage(RUSAGE_CHILDREN, &childBefore);
+
+  result = processLine(shell, userInput);
 
+  getrusage(RUSAGE_CHILDREN, &childAfter);
+  getrusage(RUSAGE_SELF, &selfAfter);
+  clock_gettime(CLOCK_MONOTONIC, &end);
 
+  timersub(&childAfter.ru_utime, &childBefore.ru_utime, &user);
+  timersub(&selfAfter.ru_utime, &selfBefore.ru_utime, &delta);
+  timeradd(&user, &delta, &user);
+  timersub(&childAfter.ru_stime, &childBefore.ru_stime, &sys);
+  timersub(&selfAfter.ru_stime, &selfBefore.ru_stime, &delta);
+  timeradd(&sys, &delta, &sys);
+
+  printf("real %.3fs\nuser %.3fs\nsys  %.3fs\n",
+         (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9,
+         user.tv_sec + user.tv_usec / 1e6, sys.tv_sec + sys.tv_usec / 1e6);
+  fflush(stdout);
+  return result;
+}
 
 /**
- *  This function takes a LinkedList struct as a parameter and performs
- *  all of the necessary memory cleanup. It should be called just before the
- *  program exits.
+ *  This function takes the shell's SIGCHLD signalfd and the table of
+ *  background jobs. If any SIGCHLD has been delivered since the last call,
+ *  it reaps every child that has exited with wait4(-1, WNOHANG), looks it
+ *  up in the job table by pid, records its resource usage, and reports and
+ *  removes it. Without a pending
+ *  SIGCHLD it costs a single non-blocking read.
+ *  Returns the number of background jobs reaped.
  */
-void cleanUpBeforeExit(struct LinkedList* commands) 
+int reapBackground(int sigFd, struct JobTable* jobs)
 {
-  struct Iterator* iterator = createIterator(commands);
-  struct Command* currentCommand = NULL;
+  struct signalfd_siginfo info;
+  struct Job* job = NULL;
+  int delivered = 0;
+  int reaped = 0;
+  int status;
+  struct rusage usage;
+  pid_t bgPid;
 
-  // Destroy/free all of the command structs before we destroy the LinkedList
-  while (iteratorHasNext(iterator)) {
-    currentCommand = iteratorNext(iterator);
-    destroyCommand(currentCommand);
+  // Drain the signalfd; several exits may have been coalesced into one signal
+  while (read(sigFd, &info, sizeof(info)) == sizeof(info)) {
+    delivered = 1;
+  }
+  if (!delivered) {
+    return 0;
   }
 
-  // Destroy/free the iterator we created for this function
-  iteratorDestroy(iterator);
-  linkedListDestroy(commands);
+  TRACE_BEGIN(TRACE_REAP);
+  while ((bgPid = wait4(-1, &status, WNOHANG, &usage)) > 0) {
+    job = jobTableFindPid(jobs, bgPid);
+    if (job != NULL) {
+      reportJobDone(jobs, job, status, &usage);
+      reaped++;
+    }
+  }
+  TRACE_END(TRACE_REAP, reaped);
+
+  return reaped;
+}
+
+/**
+ *  This function reports finished background jobs and collects the output
+ *  they have captured since the last call, without waiting for either.
+ */
+void serviceBackground(struct Shell* shell)
+{
+  eventLoopWait(0);
+  reapBackground(shell->sigFd, shell->bgJobs);
+}
+
+/**
+ *  This function reports that a background job has finished with the given
+ *  wait status and the resources wait4() says it used, then removes it from
+ *  the job table. Output it was still
+ *  writing is collected first.
+ */
+void reportJobDone(struct JobTable* jobs, struct Job* job, int status,
+                   const struct rusage* usage)
+{
+  captureJobDone(job->id);
+  jobFinished(job, status, usage);
+  if (WIFEXITED(status)) {
+    printf("background pid %d is done: exit value %d", job->pid, WEXITSTATUS(status));
+  } else {
+    printf("background pid %d is done: terminated by signal %d", job->pid, WTERMSIG(status));
+  }
+  printf(" (user %.3fs sys %.3fs max rss %u KB)\n",
+         job->userMillis / 1e3, job->sysMillis / 1e3, job->maxRssKB);
+  fflush(stdout);
+  jobTableRemove(jobs, job);
+}
+
+/**
+ *  The event loop handler for stdin while waiting for input.
+ */
+static void onInput(int fd, void* data)
+{
+  *(int*)data = 1;
+}
+
+/**
+ *  This function returns the prompt the shell shows for its next line:
+ *  "> " while the lines of a loop are being written, and ": " otherwise.
+ */
+const char* currentPrompt(struct Shell* shell)
+{
+  return shell->pending.length > 0 ? "> " : ": ";
+}
+
+/**
+ *  The event loop handler for the SIGCHLD signalfd while waiting for input.
+ *  The prompt that was showing is redrawn after the report.
+ */
+static void onChildExit(int fd, void* data)
+{
+  struct Shell* shell = data;
+
+  if (reapBackground(fd, shell->bgJobs) > 0) {
+    printf("%s", currentPrompt(shell));
+    fflush(stdout);
+  }
+}
+
+/**
+ *  This function blocks until there is input to read on stdin. While the
+ *  shell waits, the event loop also listens on the SIGCHLD signalfd, so
+ *  background completions are reported as soon as they happen and the
+ *  prompt is redrawn afterwards, and on everything else it watches, such
+ *  as the control socket and the pipes of jobs whose output is being
+ *  captured.
+ *  It is called only once the line reader has no whole line buffered,
+ *  since epoll cannot see input that has already been read. A regular file
+ *  cannot be watched with epoll; it is read straight away and background
+ *  commands are reaped between lines.
+ */
+void waitForInput(struct Shell* shell)
+{
+  int ready = 0;
+
+  if (eventLoopAdd(STDIN_FILENO, onInput, &ready) == -1) {
+    return;
+  }
+  eventLoopAdd(shell->sigFd, onChildExit, shell);
+  while (!ready) {
+    // SIGTSTP interrupts the wait; just go back to waiting
+    if (eventLoopWait(-1) == -1 && errno != EINTR) {
+      break;
+    }
+  }
+  eventLoopRemove(shell->sigFd);
+  eventLoopRemove(STDIN_FILENO);
+}
+
+/**
+ *  This function takes the JobTable as a parameter and performs all of the
+ *  necessary memory cleanup. It should be called just before the program
+ *  exits.
+ */
+void cleanUpBeforeExit(struct JobTable* jobs)
+{
+  // Destroying the table destroys the commands of any jobs still running
+  jobTableDestroy(jobs);
 }
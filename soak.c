@@ -0,0 +1,550 @@
+/*
+ * Filename: soak.c
+ * Last modified: 16 October 2026
+ * Description: This is the load test for the shell's background path, built
+ * and run by "make soak". It starts the shell on a pseudo-terminal, so that
+ * it runs interactively and reports finished jobs from its event loop, and
+ * feeds it background jobs at a fixed rate, alternating "sleep D &" and
+ * "true &":
+ *
+ *   smallsh-soak [-n jobs] [-r jobs-per-second] [-d sleep-seconds]
+ *                [-i sample-seconds] [shell]
+ *
+ * The defaults are 20000 jobs at 500 per second sleeping 4 seconds, so that
+ * about 1000 jobs are running at once. For each job it measures the launch
+ * latency (line written to "background pid is") and the notification
+ * latency (line written to "background pid N is done", less the sleep).
+ * Every sample interval it prints one line of JSON with the shell's CPU
+ * usage, RSS and open descriptors, read from /proc; at the end it prints
+ * the latency percentiles and a verdict. RSS is also given without the
+ * pages of mapped files, since the history file is mapped and its pages
+ * count towards RSS as the shell writes through it, up to the file's size.
+ *
+ * The run fails if a job is not reported within 30 seconds, if the shell
+ * prints anything unexpected, or if anything grows with the number of jobs
+ * run: anonymous RSS, descriptors, CPU usage or notification latency in the last
+ * quarter of the run compared with the second quarter (the first is left
+ * out as warm-up), or descriptors at the end compared with the start.
+ */
+
+#define _GNU_SOURCE   // posix_openpt()
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#define NOTIFY_TIMEOUT_NS 30000000000LL
+
+struct Sample
+{
+  double time;        // Seconds since the first job was sent
+  long sent;
+  long done;
+  double cpuPercent;  // Of one CPU, since the last sample
+  long rssKB;
+  long anonKB;        // RSS less the pages of mapped files
+  int fds;
+};
+
+static struct Sample* samples = NULL;
+static int numSamples = 0;
+
+/**
+ * Returns the current monotonic time in nanoseconds.
+ */
+static long long now()
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+static int compareLongLong(const void* a, const void* b)
+{
+  long long x = *(const long long*)a;
+  long long y = *(const long long*)b;
+
+  return (x > y) - (x < y);
+}
+
+/**
+ * Returns the median of count latencies, ignoring those below 0 (jobs that
+ * never got that far). The latencies are sorted in place.
+ */
+static long long median(long long* latencies, int count)
+{
+  int first = 0;
+
+  qsort(latencies, count, sizeof(long long), compareLongLong);
+  while (first < count && latencies[first] < 0) {
+    first++;
+  }
+  return first < count ? latencies[first + (count - first) / 2] : 0;
+}
+
+/**
+ * Prints the percentiles of count latencies as a line of JSON, in the same
+ * form as smallsh-bench. The latencies are sorted in place.
+ */
+static void report(const char* name, long long* latencies, int count)
+{
+  long long total = 0;
+  int first = 0;
+  int n;
+
+  qsort(latencies, count, sizeof(long long), compareLongLong);
+  while (first < count && latencies[first] < 0) {
+    first++;
+  }
+  latencies += first;
+  n = count - first;
+  if (n == 0) {
+    return;
+  }
+  for (int i = 0; i < n; i++) {
+    total += latencies[i];
+  }
+  printf("{\"soak\": \"%s\", \"n\": %d, \"mean_ns\": %lld, \"p50_ns\": %lld, "
+         "\"p90_ns\": %lld, \"p99_ns\": %lld, \"max_ns\": %lld}\n",
+         name, n, total / n, latencies[n / 2], latencies[(int)(n * 0.90)],
+         latencies[(int)(n * 0.99)], latencies[n - 1]);
+  fflush(stdout);
+}
+
+/**
+ * Returns the CPU time the process has used, in clock ticks, or -1.
+ */
+static long cpuTicks(pid_t pid)
+{
+  char path[64];
+  char text[1024];
+  char* fields;
+  unsigned long user, sys;
+  FILE* file;
+  size_t length;
+
+  sprintf(path, "/proc/%d/stat", pid);
+  file = fopen(path, "r");
+  if (file == NULL) {
+    return -1;
+  }
+  length = fread(text, 1, sizeof(text) - 1, file);
+  fclose(file);
+  text[length] = '\0';
+  // The command name may contain spaces, so count fields from its ")"
+  fields = strrchr(text, ')');
+  if (fields == NULL
+      || sscanf(fields + 2, "%*c %*d %*d %*d %*d %*d %*u %*u %*u %*u %*u %lu %lu",
+                &user, &sys) != 2) {
+    return -1;
+  }
+  return user + sys;
+}
+
+/**
+ * Reads the resident set size of the process, in all and anonymous only,
+ * in kilobytes. Either is -1 if it cannot be read.
+ */
+static void residentKB(pid_t pid, long* rssKB, long* anonKB)
+{
+  char path[64];
+  char line[256];
+  FILE* file;
+
+  *rssKB = -1;
+  *anonKB = -1;
+  sprintf(path, "/proc/%d/status", pid);
+  file = fopen(path, "r");
+  if (file == NULL) {
+    return;
+  }
+  while (fgets(line, sizeof(line), file) != NULL) {
+    sscanf(line, "VmRSS: %ld", rssKB);
+    sscanf(line, "RssAnon: %ld", anonKB);
+  }
+  fclose(file);
+}
+
+/**
+ * Returns the number of descriptors the process has open, or -1.
+ */
+static int openFDs(pid_t pid)
+{
+  char path[64];
+  struct dirent* entry;
+  int count = 0;
+  DIR* dir;
+
+  sprintf(path, "/proc/%d/fd", pid);
+  dir = opendir(path);
+  if (dir == NULL) {
+    return -1;
+  }
+  while ((entry = readdir(dir)) != NULL) {
+    count += entry->d_name[0] != '.';
+  }
+  closedir(dir);
+  return count;
+}
+
+/**
+ * Records and prints a sample of the shell's resource usage.
+ */
+static void takeSample(pid_t shellPid, long long start, long sent, long done)
+{
+  static long long lastTime = 0;
+  static long lastTicks = 0;
+  struct Sample* sample;
+  long long time = now();
+  long ticks = cpuTicks(shellPid);
+
+  samples = realloc(samples, (numSamples + 1) * sizeof(struct Sample));
+  sample = &samples[numSamples++];
+  sample->time = (time - start) / 1e9;
+  sample->sent = sent;
+  sample->done = done;
+  sample->cpuPercent = 0;
+  if (lastTime != 0 && time > lastTime) {
+    sample->cpuPercent = 100.0 * (ticks - lastTicks) / sysconf(_SC_CLK_TCK)
+                         / ((time - lastTime) / 1e9);
+  }
+  residentKB(shellPid, &sample->rssKB, &sample->anonKB);
+  sample->fds = openFDs(shellPid);
+  lastTime = time;
+  lastTicks = ticks;
+
+  printf("{\"soak\": \"sample\", \"t\": %.2f, \"sent\": %ld, \"done\": %ld, "
+         "\"cpu_pct\": %.1f, \"rss_kb\": %ld, \"anon_kb\": %ld, \"fds\": %d}\n",
+         sample->time, sample->sent, sample->done, sample->cpuPercent,
+         sample->rssKB, sample->anonKB, sample->fds);
+  fflush(stdout);
+}
+
+/**
+ * Finds the largest anonymous RSS and descriptor count and the mean CPU usage of the
+ * samples taken while jobs numbered from first up to last were being sent.
+ */
+static void summarize(long first, long last, long* rssKB, int* fds, double* cpuPercent)
+{
+  int count = 0;
+
+  *rssKB = 0;
+  *fds = 0;
+  *cpuPercent = 0;
+  for (int i = 0; i < numSamples; i++) {
+    if (samples[i].sent < first || samples[i].sent > last) {
+      continue;
+    }
+    if (samples[i].anonKB > *rssKB) {
+      *rssKB = samples[i].anonKB;
+    }
+    if (samples[i].fds > *fds) {
+      *fds = samples[i].fds;
+    }
+    *cpuPercent += samples[i].cpuPercent;
+    count++;
+  }
+  if (count > 0) {
+    *cpuPercent /= count;
+  }
+}
+
+/**
+ * Starts the shell on a new pseudo-terminal with echo turned off, and
+ * returns the terminal's master side, or -1.
+ */
+static int startShell(const char* shell, const char* historyFile, pid_t* pid)
+{
+  struct termios settings;
+  int master = posix_openpt(O_RDWR | O_NOCTTY);
+  int slave;
+
+  if (master == -1 || grantpt(master) == -1 || unlockpt(master) == -1) {
+    return -1;
+  }
+  *pid = fork();
+  if (*pid == 0) {
+    // A new session, so the terminal becomes the shell's controlling one
+    setsid();
+    slave = open(ptsname(master), O_RDWR);
+    if (slave == -1) {
+      _exit(127);
+    }
+    tcgetattr(slave, &settings);
+    settings.c_lflag &= ~(ECHO | ECHONL);
+    tcsetattr(slave, TCSANOW, &settings);
+    dup2(slave, STDIN_FILENO);
+    dup2(slave, STDOUT_FILENO);
+    dup2(slave, STDERR_FILENO);
+    close(slave);
+    close(master);
+    setenv("SMALLSH_HISTFILE", historyFile, 1);
+    execl(shell, shell, (char*)NULL);
+    perror(shell);
+    _exit(127);
+  }
+  fcntl(master, F_SETFL, O_NONBLOCK);
+  return master;
+}
+
+int main(int argc, char *argv[])
+{
+  const char* shell = "./smallsh";
+  int numJobs = 20000;
+  double rate = 500;
+  double sleepSeconds = 4;
+  double sampleSeconds = 1;
+  char historyFile[64];
+  char buffer[1 << 16];
+  char line[64];
+  char* cursor;
+  char* newline;
+  size_t buffered = 0;
+  size_t lineLength = 0;
+  size_t lineWritten = 0;
+  long long* sentAt;
+  long long* launchLatency;
+  long long* notifyLatency;
+  int* jobOfPid;
+  long pidMax = 4194304;
+  long sent = 0;
+  long launched = 0;
+  long done = 0;
+  long unexpected = 0;
+  long long start, nextSample, due, timeout, lastSent = 0;
+  struct pollfd pollFD;
+  int startFDs, endFDs;
+  int failed = 0;
+  int option;
+  int master;
+  ssize_t count;
+  pid_t shellPid, pid;
+  FILE* file;
+
+  while ((option = getopt(argc, argv, "n:r:d:i:")) != -1) {
+    switch (option) {
+      case 'n':
+        numJobs = atoi(optarg);
+        break;
+      case 'r':
+        rate = atof(optarg);
+        break;
+      case 'd':
+        sleepSeconds = atof(optarg);
+        break;
+      case 'i':
+        sampleSeconds = atof(optarg);
+        break;
+      default:
+        fprintf(stderr, "Usage: %s [-n jobs] [-r jobs-per-second] [-d sleep-seconds] "
+                "[-i sample-seconds] [shell]\n", argv[0]);
+        return 2;
+    }
+  }
+  if (optind < argc) {
+    shell = argv[optind];
+  }
+  if (numJobs < 4 || rate <= 0 || sleepSeconds < 0 || sampleSeconds <= 0) {
+    fprintf(stderr, "%s: invalid options\n", argv[0]);
+    return 2;
+  }
+
+  file = fopen("/proc/sys/kernel/pid_max", "r");
+  if (file != NULL) {
+    if (fscanf(file, "%ld", &pidMax) != 1) {
+      pidMax = 4194304;
+    }
+    fclose(file);
+  }
+  sentAt = malloc(numJobs * sizeof(long long));
+  launchLatency = malloc(numJobs * sizeof(long long));
+  notifyLatency = malloc(numJobs * sizeof(long long));
+  jobOfPid = calloc(pidMax + 1, sizeof(int));   // Job number + 1, by pid
+  for (int i = 0; i < numJobs; i++) {
+    launchLatency[i] = -1;
+    notifyLatency[i] = -1;
+  }
+
+  signal(SIGPIPE, SIG_IGN);
+  sprintf(historyFile, "/tmp/smallsh-soak-history-%d", getpid());
+  master = startShell(shell, historyFile, &shellPid);
+  if (master == -1) {
+    perror("pseudo-terminal");
+    return 1;
+  }
+  // Let the shell reach its first prompt before counting its descriptors
+  usleep(200000);
+  startFDs = openFDs(shellPid);
+
+  pollFD.fd = master;
+  start = now();
+  nextSample = start;
+  while (1) {
+    // Write the lines that are due
+    while (sent < numJobs && now() >= (due = start + (long long)(sent / rate * 1e9))) {
+      if (lineLength == 0) {
+        lineLength = sent % 2 == 0 ? sprintf(line, "sleep %g &\n", sleepSeconds)
+                                   : sprintf(line, "true &\n");
+        lineWritten = 0;
+        sentAt[sent] = now();
+      }
+      count = write(master, line + lineWritten, lineLength - lineWritten);
+      if (count <= 0) {
+        break;    // The terminal's input queue is full; wait for POLLOUT
+      }
+      lineWritten += count;
+      if (lineWritten == lineLength) {
+        lineLength = 0;
+        lastSent = now();
+        sent++;
+      }
+    }
+
+    if (now() >= nextSample) {
+      takeSample(shellPid, start, sent, done);
+      nextSample += (long long)(sampleSeconds * 1e9);
+    }
+    if (sent == numJobs && done >= numJobs) {
+      break;
+    }
+    if (sent == numJobs && now() - lastSent > NOTIFY_TIMEOUT_NS + sleepSeconds * 1e9) {
+      printf("{\"soak\": \"error\", \"message\": \"%ld of %d jobs were never reported\"}\n",
+             numJobs - done, numJobs);
+      failed = 1;
+      break;
+    }
+
+    // Sleep until the next line or sample is due, or the shell writes
+    timeout = nextSample;
+    if (sent < numJobs && start + (long long)(sent / rate * 1e9) < timeout) {
+      timeout = start + (long long)(sent / rate * 1e9);
+    }
+    timeout = (timeout - now()) / 1000000;
+    pollFD.events = POLLIN | (lineLength > 0 ? POLLOUT : 0);
+    if (poll(&pollFD, 1, timeout < 0 ? 0 : (int)timeout + 1) == -1 && errno != EINTR) {
+      break;
+    }
+    if (!(pollFD.revents & (POLLIN | POLLHUP))) {
+      continue;
+    }
+
+    count = read(master, buffer + buffered, sizeof(buffer) - 1 - buffered);
+    if (count <= 0) {
+      if (count == -1 && errno == EAGAIN) {
+        continue;
+      }
+      printf("{\"soak\": \"error\", \"message\": \"the shell exited\"}\n");
+      failed = 1;
+      break;
+    }
+    buffered += count;
+    buffer[buffered] = '\0';
+
+    cursor = buffer;
+    while ((newline = strchr(cursor, '\n')) != NULL) {
+      *newline = '\0';
+      if (newline > cursor && newline[-1] == '\r') {
+        newline[-1] = '\0';
+      }
+      // Notices are written after a prompt, or several
+      while (strncmp(cursor, ": ", 2) == 0) {
+        cursor += 2;
+      }
+      if (sscanf(cursor, "background pid is %d", &pid) == 1 && launched < numJobs) {
+        launchLatency[launched] = now() - sentAt[launched];
+        if (pid > 0 && pid <= pidMax) {
+          jobOfPid[pid] = launched + 1;
+        }
+        launched++;
+      } else if (sscanf(cursor, "background pid %d is done", &pid) == 1
+                 && pid > 0 && pid <= pidMax && jobOfPid[pid] != 0) {
+        long job = jobOfPid[pid] - 1;
+        notifyLatency[job] = now() - sentAt[job] - (job % 2 == 0 ? sleepSeconds * 1e9 : 0);
+        if (notifyLatency[job] < 0) {
+          notifyLatency[job] = 0;
+        }
+        jobOfPid[pid] = 0;
+        done++;
+      } else if (*cursor != '\0' && *cursor != ':') {
+        if (unexpected == 0) {
+          printf("{\"soak\": \"error\", \"message\": \"unexpected output: %.80s\"}\n", cursor);
+        }
+        unexpected++;
+      }
+      cursor = newline + 1;
+    }
+    buffered -= cursor - buffer;
+    memmove(buffer, cursor, buffered);
+  }
+
+  // Give the shell a moment to get back to its prompt, then look at it once
+  // more and let it go
+  usleep(200000);
+  takeSample(shellPid, start, sent, done);
+  endFDs = openFDs(shellPid);
+  write(master, "exit\n", 5);
+  waitpid(shellPid, NULL, 0);
+  close(master);
+  unlink(historyFile);
+
+  // Growth: the last quarter of the run against the second quarter
+  {
+    long earlyRSS, lateRSS;
+    int earlyFDs, lateFDs;
+    double earlyCPU, lateCPU;
+    long long earlyNotify, lateNotify;
+    int quarter = numJobs / 4;
+
+    summarize(quarter, 2 * quarter, &earlyRSS, &earlyFDs, &earlyCPU);
+    summarize(3 * quarter, numJobs - 1, &lateRSS, &lateFDs, &lateCPU);
+    earlyNotify = median(notifyLatency + quarter, quarter);
+    lateNotify = median(notifyLatency + 3 * quarter, numJobs - 3 * quarter);
+
+    report("launch", launchLatency, numJobs);
+    report("notify", notifyLatency, numJobs);
+
+    if (unexpected > 0) {
+      printf("{\"soak\": \"fail\", \"reason\": \"unexpected output\", \"lines\": %ld}\n",
+             unexpected);
+      failed = 1;
+    }
+    if (lateRSS > earlyRSS * 5 / 4 + 1024) {
+      printf("{\"soak\": \"fail\", \"reason\": \"anonymous rss grew\", \"from_kb\": %ld, \"to_kb\": %ld}\n",
+             earlyRSS, lateRSS);
+      failed = 1;
+    }
+    if (lateFDs > earlyFDs + 4 || endFDs > startFDs) {
+      printf("{\"soak\": \"fail\", \"reason\": \"descriptors grew\", \"start\": %d, "
+             "\"early\": %d, \"late\": %d, \"end\": %d}\n", startFDs, earlyFDs, lateFDs, endFDs);
+      failed = 1;
+    }
+    if (lateCPU > earlyCPU * 2 + 5) {
+      printf("{\"soak\": \"fail\", \"reason\": \"cpu grew\", \"from_pct\": %.1f, "
+             "\"to_pct\": %.1f}\n", earlyCPU, lateCPU);
+      failed = 1;
+    }
+    if (lateNotify > earlyNotify * 2 + 2000000) {
+      printf("{\"soak\": \"fail\", \"reason\": \"notification latency grew\", "
+             "\"from_ns\": %lld, \"to_ns\": %lld}\n", earlyNotify, lateNotify);
+      failed = 1;
+    }
+  }
+
+  printf("{\"soak\": \"%s\", \"jobs\": %d, \"launched\": %ld, \"done\": %ld}\n",
+         failed ? "fail" : "pass", numJobs, launched, done);
+  free(sentAt);
+  free(launchLatency);
+  free(notifyLatency);
+  free(jobOfPid);
+  free(samples);
+  return failed;
+}
@@ -0,0 +1,61 @@
+#!/bin/sh
+#
+# Filename: test.sh
+# Last modified: 16 October 2026
+# Description: Runs the shell on short command lines and checks what they
+# print. Usage: ./test.sh [shell], as run by "make test". Exits with the
+# number of checks that failed.
+#
+
+SHELL_UNDER_TEST=$(realpath "${1:-./smallsh}")
+export SMALLSH_HISTFILE=
+failures=0
+
+# check NAME EXPECTED ACTUAL: compares what a test printed with what it should
+check()
+{
+  if [ "$2" = "$3" ]; then
+    echo "ok   $1"
+  else
+    echo "FAIL $1"
+    echo "  expected: $(printf '%s' "$2" | tr '\n' '|')"
+    echo "  actual:   $(printf '%s' "$3" | tr '\n' '|')"
+    failures=$((failures + 1))
+  fi
+}
+
+# Commands launched through the zygote run in the directory the shell has
+# cd'd to, not the one the zygote was started in
+check "zygote follows cd" "/usr
+bin
+/" "$(cd / && SMALLSH_ZYGOTE=1 "$SHELL_UNDER_TEST" -c 'cd /usr; /bin/pwd; ls -d bin; cd /; /bin/pwd')"
+
+# Background jobs report their resource usage in "jobs -l" and when done
+usage=$("$SHELL_UNDER_TEST" -c 'sleep 0.2 &
+jobs -l
+wait' | sed -n 's/.*\(user [0-9.]*s sys [0-9.]*s max rss [0-9]* KB\).*/\1/p' | sed 's/[0-9.]\+/N/g')
+check "background job usage" "user Ns sys Ns max rss N KB
+user Ns sys Ns max rss N KB" "$usage"
+
+# The control socket answers while the shell is blocked reading a pipe; the
+# query is sent during the sleep before the next line arrives
+if command -v python3 > /dev/null; then
+  socket=$(mktemp -u /tmp/smallsh-test-XXXXXX.sock)
+  (echo 'sleep 3 &'; sleep 2; echo 'exit') | SMALLSH_CONTROL=$socket "$SHELL_UNDER_TEST" > /dev/null &
+  sleep 1
+  check "control socket on piped input" "sleep 3 & running" "$(python3 - "$socket" <<'END'
+import json, socket, sys
+client = socket.socket(socket.AF_UNIX)
+client.settimeout(0.5)
+client.connect(sys.argv[1])
+client.sendall(b"jobs\n")
+job = json.loads(client.makefile().readline())["jobs"][0]
+print(job["command"], job["state"])
+END
+)"
+  wait
+else
+  echo "skip control socket on piped input (no python3)"
+fi
+
+exit $failures
@@ -0,0 +1,109 @@
+/*
+ * Filename: trace.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for phase tracing. With
+ * SMALLSH_TRACE set to a file name, events are recorded into a buffer of
+ * 64K events (SMALLSH_TRACE_EVENTS changes the number), which is appended
+ * to the file whenever it fills and when the shell exits. Recording an
+ * event is a clock_gettime() through the vDSO and a 16-byte store, so
+ * tracing can be left on.
+ */
+
+#include "trace.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+struct TraceEvent* traceNext = NULL;
+static struct TraceEvent* traceStart = NULL;
+static struct TraceEvent* traceEnd = NULL;
+static int traceFD = -1;
+
+const char* const tracePhaseNames[TRACE_NUM_PHASES] = {
+  "read", "plan", "expand", "parse", "instantiate", "spawn", "wait", "reap"
+};
+
+/**
+ *  This function creates the trace file and a buffer of numEvents events,
+ *  and turns tracing on.
+ *  Returns 0, or -1 after printing why the file could not be created.
+ */
+int traceOpen(const char* fileName, int numEvents)
+{
+  struct TraceHeader header;
+
+  if (numEvents <= 0) {
+    numEvents = 1 << 16;
+  }
+  traceFD = open(fileName, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (traceFD == -1) {
+    perror(fileName);
+    return -1;
+  }
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, TRACE_MAGIC, sizeof(header.magic));
+  header.pid = getpid();
+  header.eventSize = sizeof(struct TraceEvent);
+  write(traceFD, &header, sizeof(header));
+
+  traceStart = malloc(numEvents * sizeof(struct TraceEvent));
+  if (traceStart == NULL) {
+    close(traceFD);
+    traceFD = -1;
+    return -1;
+  }
+  traceEnd = traceStart + numEvents;
+  traceNext = traceStart;
+  return 0;
+}
+
+/**
+ *  This function records one event; it is called through TRACE_BEGIN and
+ *  TRACE_END, which only call it while tracing is on.
+ */
+void traceRecord(int phase, int end, int arg)
+{
+  struct timespec now;
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  traceNext->time = (uint64_t)now.tv_sec * 1000000000u + now.tv_nsec;
+  traceNext->arg = arg;
+  traceNext->phase = phase;
+  traceNext->end = end;
+  if (++traceNext == traceEnd) {
+    traceFlush();
+  }
+}
+
+/**
+ *  This function appends the events recorded so far to the trace file and
+ *  empties the buffer.
+ */
+void traceFlush()
+{
+  if (traceNext == NULL || traceNext == traceStart) {
+    return;
+  }
+  write(traceFD, traceStart, (traceNext - traceStart) * sizeof(struct TraceEvent));
+  traceNext = traceStart;
+}
+
+/**
+ *  This function writes out what is left in the buffer and turns tracing
+ *  off.
+ */
+void traceClose()
+{
+  if (traceNext == NULL) {
+    return;
+  }
+  traceFlush();
+  close(traceFD);
+  free(traceStart);
+  traceNext = NULL;
+  traceStart = NULL;
+  traceEnd = NULL;
+}
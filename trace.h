@@ -0,0 +1,62 @@
+/*
+ * Filename: trace.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for phase tracing.
+ * With tracing on, the shell records a timestamped begin and end event for
+ * each phase of running a line into a binary buffer, which trace2json turns
+ * into a Chrome trace. With it off, TRACE_BEGIN and TRACE_END cost a single
+ * test of a global pointer.
+ */
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <stdint.h>
+
+// The phases, in the order of their names in tracePhaseNames
+enum TracePhase
+{
+  TRACE_READ,         // Reading a line of input
+  TRACE_PLAN,         // Looking up or compiling the line's plan
+  TRACE_EXPAND,       // variableExpand() of a pipeline
+  TRACE_PARSE,        // createPipeline()
+  TRACE_INSTANTIATE,  // Filling in a pipeline template instead of both
+  TRACE_SPAWN,        // Starting one child, up to its exec
+  TRACE_WAIT,         // Waiting for a foreground child
+  TRACE_REAP,         // Reaping and reporting finished background jobs
+  TRACE_NUM_PHASES
+};
+
+// One event as stored in the buffer and the file
+struct TraceEvent
+{
+  uint64_t time;    // CLOCK_MONOTONIC, in nanoseconds
+  int32_t arg;      // The child's pid for spawn and wait, jobs reaped for reap
+  uint16_t phase;
+  uint16_t end;     // 0 for the begin event, 1 for the end event
+};
+
+// The file starts with this header, followed by the events
+struct TraceHeader
+{
+  char magic[8];    // TRACE_MAGIC
+  int32_t pid;
+  int32_t eventSize;
+};
+
+#define TRACE_MAGIC "SMTRACE1"
+
+#define TRACE_BEGIN(phase) \
+  do { if (traceNext != NULL) traceRecord(phase, 0, 0); } while (0)
+#define TRACE_END(phase, arg) \
+  do { if (traceNext != NULL) traceRecord(phase, 1, arg); } while (0)
+
+extern struct TraceEvent* traceNext;  // Next free event, or NULL when off
+extern const char* const tracePhaseNames[TRACE_NUM_PHASES];
+
+int traceOpen(const char* fileName, int numEvents);
+void traceRecord(int phase, int end, int arg);
+void traceFlush();
+void traceClose();
+
+#endif
@@ -0,0 +1,65 @@
+/*
+ * Filename: trace2json.c
+ * Last modified: 16 October 2026
+ * Description: This is the converter from the binary trace files written by
+ * the shell with SMALLSH_TRACE to the Chrome trace event format, which
+ * chrome://tracing and ui.perfetto.dev both open:
+ *
+ *   trace2json trace.bin > trace.json
+ *
+ * Each phase becomes a pair of "B" and "E" events on the shell's thread,
+ * with timestamps in microseconds from the first event.
+ */
+
+#include "trace.h"
+#include <stdio.h>
+#include <string.h>
+
+int main(int argc, char *argv[])
+{
+  struct TraceHeader header;
+  struct TraceEvent event;
+  uint64_t start = 0;
+  long numEvents = 0;
+  FILE* in;
+
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s trace-file\n", argv[0]);
+    return 2;
+  }
+  in = fopen(argv[1], "rb");
+  if (in == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+  if (fread(&header, sizeof(header), 1, in) != 1
+      || memcmp(header.magic, TRACE_MAGIC, sizeof(header.magic)) != 0
+      || header.eventSize != sizeof(struct TraceEvent)) {
+    fprintf(stderr, "%s: not a smallsh trace\n", argv[1]);
+    fclose(in);
+    return 1;
+  }
+
+  printf("{\"traceEvents\":[\n");
+  printf("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"smallsh\"}}",
+         header.pid);
+  while (fread(&event, sizeof(event), 1, in) == 1) {
+    if (event.phase >= TRACE_NUM_PHASES) {
+      continue;
+    }
+    if (numEvents == 0) {
+      start = event.time;
+    }
+    printf(",\n{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%.3f,\"pid\":%d,\"tid\":%d",
+           tracePhaseNames[event.phase], event.end ? "E" : "B",
+           (event.time - start) / 1e3, header.pid, header.pid);
+    if (event.end && event.arg != 0) {
+      printf(",\"args\":{\"%s\":%d}", event.phase == TRACE_REAP ? "jobs" : "pid", event.arg);
+    }
+    printf("}");
+    numEvents++;
+  }
+  printf("\n],\"displayTimeUnit\":\"ns\"}\n");
+  fclose(in);
+  return 0;
+}
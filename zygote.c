@@ -0,0 +1,400 @@
+/*
+ * Filename: zygote.c
+ * Last modified: 16 October 2026
+ * Description: This is the implementation file for the zygote. It is forked
+ * from the shell at startup, while the shell's address space is still
+ * small, and then serves launch requests over a socketpair: the path,
+ * arguments and environment travel in the message, and the redirection
+ * descriptors and the shell's current directory are passed with
+ * SCM_RIGHTS, so a command starts wherever the shell has cd'd to. The zygote creates each command
+ * with clone(CLONE_PARENT), so the command is a child of the shell rather
+ * than of the zygote. The shell therefore gets SIGCHLD for it and collects
+ * its exit status and resource usage with wait4() exactly as for a command
+ * it launched itself, and the zygote only has to send back the pid.
+ *
+ * If a request cannot be sent, for example because it is too large or the
+ * zygote has gone away, the caller launches the command itself.
+ */
+
+#define _GNU_SOURCE   // clone flags
+#include "zygote.h"
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+
+// The largest request, strings included; larger ones are launched directly
+#define MAX_REQUEST (1 << 16)
+
+extern char** environ;
+
+struct SpawnRequest
+{
+  int numArgs;
+  int numEnv;
+  int foreground;   // Reset SIGINT to its default in the command
+  int redirected;   // Bit i set if a descriptor is passed for fd i, in order;
+                    // the shell's directory always follows them
+  pid_t pgid;       // -1 to stay in the shell's process group
+  size_t length;    // Bytes of strings after the header: path, args, env
+};
+
+struct SpawnReply
+{
+  int error;        // 0, or the errno value of the failed launch
+  pid_t pid;
+};
+
+static int zygoteFD = -1;
+static pid_t zygotePid = 0;
+static char requestBuffer[MAX_REQUEST];
+
+/**
+ * Appends a null-terminated string to the request buffer.
+ * Returns 0, or -1 if it does not fit.
+ */
+static int appendString(size_t* used, const char* text)
+{
+  size_t length = strlen(text) + 1;
+
+  if (*used + length > MAX_REQUEST) {
+    return -1;
+  }
+  memcpy(requestBuffer + *used, text, length);
+  *used += length;
+  return 0;
+}
+
+/**
+ * Splits the strings after a request's header into the path and
+ * NULL-terminated argument and environment arrays.
+ * Returns the path, or NULL if the request is malformed.
+ */
+static char* unpackRequest(struct SpawnRequest* request, size_t received,
+                           char*** args, char*** env)
+{
+  char* text = requestBuffer + sizeof(struct SpawnRequest);
+  char* end = requestBuffer + received;
+  char* path;
+
+  if (received < sizeof(struct SpawnRequest) || end[-1] != '\0'
+      || request->numArgs < 1 || request->numEnv < 0
+      || sizeof(struct SpawnRequest) + request->length != received) {
+    return NULL;
+  }
+  *args = malloc((request->numArgs + 1) * sizeof(char*));
+  *env = malloc((request->numEnv + 1) * sizeof(char*));
+
+  path = text;
+  text += strlen(text) + 1;
+  for (int i = 0; i < request->numArgs + request->numEnv; i++) {
+    if (text >= end) {
+      free(*args);
+      free(*env);
+      return NULL;
+    }
+    if (i < request->numArgs) {
+      (*args)[i] = text;
+    } else {
+      (*env)[i - request->numArgs] = text;
+    }
+    text += strlen(text) + 1;
+  }
+  (*args)[request->numArgs] = NULL;
+  (*env)[request->numEnv] = NULL;
+  return path;
+}
+
+// What the zygote's clone() child needs to start a command
+struct LaunchArgs
+{
+  struct SpawnRequest* request;
+  const char* path;
+  char** args;
+  char** env;
+  int stdFDs[3];    // Become the command's fds 0-2; -1 to inherit
+  int dirFD;        // The directory to run the command in
+  const sigset_t* childMask;
+  int error;        // Set by the child if the exec fails
+};
+
+/**
+ * Sets up and executes the command in the child. It shares the zygote's
+ * memory, so it only makes system calls, and an exec failure is reported
+ * by storing errno where the zygote will see it.
+ */
+static int launchChild(void* data)
+{
+  struct LaunchArgs* launch = data;
+
+  // The child does not share the zygote's directory, only its memory
+  if (fchdir(launch->dirFD) == -1) {
+    launch->error = errno;
+    _exit(127);
+  }
+  if (launch->request->pgid != -1) {
+    setpgid(0, launch->request->pgid);
+  }
+  for (int i = 0; i < 3; i++) {
+    if (launch->stdFDs[i] != -1) {
+      dup2(launch->stdFDs[i], i);
+    }
+  }
+  if (launch->request->foreground) {
+    signal(SIGINT, SIG_DFL);
+  }
+  sigprocmask(SIG_SETMASK, launch->childMask, NULL);
+  execve(launch->path, launch->args, launch->env);
+  launch->error = errno;
+  _exit(127);
+}
+
+/**
+ * Launches one command for a request, as a child of the shell. Like
+ * posix_spawn(), the child shares the zygote's memory and the zygote is
+ * suspended until it has exec'd or failed to, so nothing is copied.
+ * Returns 0 and stores the pid, or an errno value.
+ */
+static int zygoteLaunch(struct LaunchArgs* launch, pid_t* childPid)
+{
+  static char stack[1 << 16];
+  pid_t pid;
+
+  launch->error = 0;
+  pid = clone(launchChild, stack + sizeof(stack),
+              CLONE_PARENT | CLONE_VM | CLONE_VFORK | SIGCHLD, launch);
+  if (pid == -1) {
+    return errno;
+  }
+  *childPid = pid;
+  return launch->error;
+}
+
+/**
+ * The zygote's main loop: receive a request, launch it and reply, until the
+ * shell closes its end of the socket.
+ */
+static void zygoteServe(int fd, const sigset_t* childMask)
+{
+  struct SpawnRequest request;
+  struct SpawnReply reply;
+  struct LaunchArgs launch;
+  struct msghdr message;
+  struct iovec part;
+  struct cmsghdr* control;
+  char controlBuffer[CMSG_SPACE(4 * sizeof(int))];
+  int fds[4];
+  int numFDs;
+  char** args;
+  char** env;
+  char* path;
+  ssize_t received;
+
+  while (1) {
+    part.iov_base = requestBuffer;
+    part.iov_len = MAX_REQUEST;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &part;
+    message.msg_iovlen = 1;
+    message.msg_control = controlBuffer;
+    message.msg_controllen = sizeof(controlBuffer);
+
+    received = recvmsg(fd, &message, MSG_CMSG_CLOEXEC);
+    if (received == -1 && errno == EINTR) {
+      continue;
+    }
+    if (received <= 0) {
+      return;
+    }
+
+    numFDs = 0;
+    control = CMSG_FIRSTHDR(&message);
+    if (control != NULL && control->cmsg_level == SOL_SOCKET
+        && control->cmsg_type == SCM_RIGHTS) {
+      numFDs = (control->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+      numFDs = numFDs < 4 ? numFDs : 4;
+      memcpy(fds, CMSG_DATA(control), numFDs * sizeof(int));
+    }
+
+    memcpy(&request, requestBuffer, sizeof(request));
+    reply.pid = 0;
+    path = unpackRequest(&request, received, &args, &env);
+    if (path == NULL || numFDs != __builtin_popcount(request.redirected & 7) + 1) {
+      if (path != NULL) {
+        free(args);
+        free(env);
+      }
+      reply.error = EINVAL;
+    } else {
+      launch.request = &request;
+      launch.path = path;
+      launch.args = args;
+      launch.env = env;
+      for (int i = 0, next = 0; i < 3; i++) {
+        launch.stdFDs[i] = (request.redirected & (1 << i)) ? fds[next++] : -1;
+      }
+      launch.dirFD = fds[numFDs - 1];
+      launch.childMask = childMask;
+      reply.error = zygoteLaunch(&launch, &reply.pid);
+      free(args);
+      free(env);
+    }
+    for (int i = 0; i < numFDs; i++) {
+      close(fds[i]);
+    }
+    send(fd, &reply, sizeof(reply), MSG_NOSIGNAL);
+  }
+}
+
+/**
+ *  This function forks the zygote. It should be called early, before the
+ *  shell has allocated much memory or opened any descriptors other than
+ *  stdin, stdout and stderr, which the commands it launches inherit.
+ *  Returns 0, or -1 if the zygote could not be started.
+ */
+int zygoteStart()
+{
+  int fds[3];
+  sigset_t childMask;
+  struct sigaction ignore = {{0}};
+
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, fds) == -1) {
+    return -1;
+  }
+
+  zygotePid = fork();
+  if (zygotePid == -1) {
+    close(fds[0]);
+    close(fds[1]);
+    return -1;
+  }
+
+  if (zygotePid == 0) {
+    close(fds[0]);
+    prctl(PR_SET_PDEATHSIG, SIGKILL);
+    // Commands start with the shell's signal mask, less SIGCHLD, and ignore
+    // SIGTSTP; SIGINT is already ignored and reset for foreground commands
+    sigprocmask(SIG_SETMASK, NULL, &childMask);
+    sigdelset(&childMask, SIGCHLD);
+    ignore.sa_handler = SIG_IGN;
+    sigaction(SIGTSTP, &ignore, NULL);
+    zygoteServe(fds[1], &childMask);
+    _exit(0);
+  }
+
+  close(fds[1]);
+  zygoteFD = fds[0];
+  return 0;
+}
+
+/**
+ *  This function tells the zygote to exit by closing the socket, and reaps
+ *  it.
+ */
+void zygoteStop()
+{
+  if (zygoteFD == -1) {
+    return;
+  }
+  close(zygoteFD);
+  zygoteFD = -1;
+  waitpid(zygotePid, NULL, 0);
+}
+
+/**
+ * Returns 1 if launches go through the zygote, and 0 otherwise.
+ */
+int zygoteRunning()
+{
+  return zygoteFD != -1;
+}
+
+/**
+ *  This function asks the zygote to launch the program at the given path
+ *  with the given arguments and the shell's environment, in the shell's
+ *  current directory. stdFDs[i] (-1 for
+ *  none) becomes its descriptor i, and pgid is the process
+ *  group to join (-1 for the shell's, 0 for a new one).
+ *  Returns 0 and stores the pid, an errno value if the command could not be
+ *  launched, or -1 if the request could not be made and the caller should
+ *  launch the command itself.
+ */
+int zygoteSpawn(const char* path, char** args, int foreground,
+                const int* stdFDs, pid_t pgid, pid_t* pid)
+{
+  struct SpawnRequest request = {0, 0, foreground, 0, pgid, 0};
+  struct SpawnReply reply;
+  struct msghdr message;
+  struct iovec part;
+  struct cmsghdr* control;
+  char controlBuffer[CMSG_SPACE(4 * sizeof(int))];
+  int fds[4];
+  int numFDs = 0;
+  int dirFD;
+  int result;
+  size_t used = sizeof(struct SpawnRequest);
+
+  if (zygoteFD == -1 || appendString(&used, path) == -1) {
+    return -1;
+  }
+  for (request.numArgs = 0; args[request.numArgs] != NULL; request.numArgs++) {
+    if (appendString(&used, args[request.numArgs]) == -1) {
+      return -1;
+    }
+  }
+  for (request.numEnv = 0; environ[request.numEnv] != NULL; request.numEnv++) {
+    if (appendString(&used, environ[request.numEnv]) == -1) {
+      return -1;
+    }
+  }
+  for (int i = 0; i < 3; i++) {
+    if (stdFDs[i] != -1) {
+      request.redirected |= 1 << i;
+      fds[numFDs++] = stdFDs[i];
+    }
+  }
+  // O_PATH opens the directory even without read permission, and fchdir()
+  // accepts it
+  dirFD = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+  if (dirFD == -1) {
+    return -1;
+  }
+  fds[numFDs++] = dirFD;
+  request.length = used - sizeof(struct SpawnRequest);
+  memcpy(requestBuffer, &request, sizeof(request));
+
+  part.iov_base = requestBuffer;
+  part.iov_len = used;
+  memset(&message, 0, sizeof(message));
+  message.msg_iov = &part;
+  message.msg_iovlen = 1;
+  message.msg_control = controlBuffer;
+  message.msg_controllen = CMSG_SPACE(numFDs * sizeof(int));
+  control = CMSG_FIRSTHDR(&message);
+  control->cmsg_level = SOL_SOCKET;
+  control->cmsg_type = SCM_RIGHTS;
+  control->cmsg_len = CMSG_LEN(numFDs * sizeof(int));
+  memcpy(CMSG_DATA(control), fds, numFDs * sizeof(int));
+
+  result = sendmsg(zygoteFD, &message, MSG_NOSIGNAL);
+  close(dirFD);
+  if (result == -1 || recv(zygoteFD, &reply, sizeof(reply), 0) != sizeof(reply)) {
+    // The zygote is gone; launch directly from now on
+    close(zygoteFD);
+    zygoteFD = -1;
+    return -1;
+  }
+
+  // A command whose exec failed has exited already; it is the shell's child
+  if (reply.error != 0 && reply.pid > 0) {
+    waitpid(reply.pid, NULL, 0);
+  }
+  *pid = reply.pid;
+  return reply.error;
+}
@@ -0,0 +1,20 @@
+/*
+ * Filename: zygote.h
+ * Last modified: 16 October 2026
+ * Description: This is the declaration/interface file for the zygote, a
+ * small helper process that launches commands on the shell's behalf. Like
+ * the path cache, there is one zygote for the whole process.
+ */
+
+#ifndef ZYGOTE_H
+#define ZYGOTE_H
+
+#include <sys/types.h>
+
+int zygoteStart();
+void zygoteStop();
+int zygoteRunning();
+int zygoteSpawn(const char* path, char** args, int foreground,
+                const int* stdFDs, pid_t pgid, pid_t* pid);
+
+#endif